@@ -0,0 +1,131 @@
+#!/usr/bin/env python3
+"""Compile throughput benchmark.
+
+Generates a set of synthetic workloads, compiles each one with the Axon compiler and reports lines/sec,
+tokens/sec and per-phase time (from --time-report). Results are compared against a stored baseline, and the script
+fails if any workload got slower than the allowed threshold.
+
+Baselines are machine specific, so none is committed. Recording one is always explicit (--update-baseline, or the
+bench_compile_record target), so a regressed build never silently becomes the baseline; comparing without one fails.
+"""
+
+import argparse
+import json
+import re
+import subprocess
+import sys
+import time
+from pathlib import Path
+
+import generate
+
+# name -> generator arguments; each workload stresses a different part of the frontend
+WORKLOADS = {
+    "many-units": dict(units=200, fanout=3, functions=8, depth=3, structs=2, array_size=4),
+    "many-functions": dict(units=4, fanout=1, functions=1000, depth=3, structs=1, array_size=4),
+    "deep-expressions": dict(units=4, fanout=1, functions=50, depth=10, structs=1, array_size=0),
+    "large-arrays": dict(units=4, fanout=1, functions=50, depth=2, structs=0, array_size=2000),
+    "many-structs": dict(units=20, fanout=1, functions=20, depth=3, structs=100, array_size=4),
+}
+
+TIME_LINE = re.compile(r"^\s*([\d.]+)\s+(\d+)\s+([\d.]+)%\s+(.+)$")
+MEM_TOTAL_LINE = re.compile(r"^\s*(\d+)\s+(\d+)\s+(\d+)\s+(\d+)\s+total$")
+
+
+def run_workload(compiler, directory, repeat):
+    best = None
+    for _ in range(repeat):
+        start = time.perf_counter()
+        result = subprocess.run(
+            [compiler, str(directory / "axon.toml"), "-o", str(directory / "out.bc"), "--time-report",
+             "--mem-report"],
+            capture_output=True, text=True)
+        elapsed = time.perf_counter() - start
+        if result.returncode != 0:
+            sys.exit(f"compilation of {directory} failed:\n{result.stdout}{result.stderr}")
+
+        phases = {}
+        tokens = 0
+        for line in result.stderr.splitlines():
+            if match := TIME_LINE.match(line):
+                phases[match.group(4)] = float(match.group(1))
+            elif match := MEM_TOTAL_LINE.match(line):
+                tokens = int(match.group(1))
+
+        if best is None or elapsed < best["seconds"]:
+            best = dict(seconds=elapsed, tokens=tokens, phases=phases)
+    return best
+
+
+def count_lines(directory):
+    return sum(len(path.read_text().splitlines()) for path in directory.rglob("*.ax"))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--compiler", required=True, type=Path)
+    parser.add_argument("--work-dir", required=True, type=Path)
+    parser.add_argument("--baseline", type=Path)
+    parser.add_argument("--update-baseline", action="store_true", help="record this run as the baseline")
+    parser.add_argument("--json", type=Path, help="also write the results to this file")
+    parser.add_argument("--threshold", type=float, default=0.15, help="allowed slowdown before failing")
+    parser.add_argument("--repeat", type=int, default=3, help="runs per workload; the fastest is kept")
+    parser.add_argument("--workload", action="append", choices=WORKLOADS.keys(), help="only run these workloads")
+    args = parser.parse_args()
+    if args.update_baseline and not args.baseline:
+        sys.exit("--update-baseline requires --baseline")
+    if args.baseline and not args.update_baseline and not args.baseline.exists():
+        sys.exit(f"no baseline at {args.baseline}; record one from a known good build with --update-baseline "
+                 f"(the bench_compile_record target)")
+
+    results = {}
+    for name in args.workload or WORKLOADS:
+        directory = args.work_dir / name
+        generate.generate_module(argparse.Namespace(seed=0, **WORKLOADS[name]), directory)
+        lines = count_lines(directory)
+        run = run_workload(args.compiler, directory, args.repeat)
+        results[name] = dict(
+            lines_per_sec=lines / run["seconds"],
+            tokens_per_sec=run["tokens"] / run["seconds"],
+            seconds=run["seconds"],
+            phases_ms=run["phases"],
+        )
+
+        print(f"== {name}: {lines} lines, {run['tokens']} tokens, {run['seconds'] * 1000:.1f} ms")
+        print(f"   {results[name]['lines_per_sec']:.0f} lines/s, {results[name]['tokens_per_sec']:.0f} tokens/s")
+        for phase, ms in run["phases"].items():
+            print(f"   {ms:>10.3f} ms  {phase}")
+
+    if args.json:
+        args.json.write_text(json.dumps(results, indent=2, sort_keys=True) + "\n")
+
+    if not args.baseline:
+        print("no baseline to compare against; pass --baseline to compare or record one")
+        return
+    if args.update_baseline:
+        args.baseline.parent.mkdir(parents=True, exist_ok=True)
+        args.baseline.write_text(json.dumps(results, indent=2, sort_keys=True) + "\n")
+        print(f"baseline written to {args.baseline}")
+        return
+
+    baseline = json.loads(args.baseline.read_text())
+    regressions = []
+    for name, result in results.items():
+        if name not in baseline:
+            continue
+        ratio = result["lines_per_sec"] / baseline[name]["lines_per_sec"]
+        print(f"{name}: {ratio:.2f}x baseline throughput")
+        if ratio < 1 - args.threshold:
+            regressions.append(name)
+            # Point at the phases that got slower so the regression is easy to track down
+            for phase, ms in result["phases_ms"].items():
+                old = baseline[name]["phases_ms"].get(phase)
+                if old and ms > old * (1 + args.threshold):
+                    print(f"   {phase}: {old:.3f} ms -> {ms:.3f} ms")
+
+    if regressions:
+        sys.exit(f"throughput regressions in: {', '.join(regressions)}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+"""Generates synthetic Axon modules for compile throughput benchmarks.
+
+The generated module is a chain of units where every unit imports from the next `fanout` units, and calls are chained
+so every function is reachable from main (unreachable functions aren't compiled at all). Each unit contains structs,
+functions with arithmetic expressions of a configurable depth, array literals, while loops and calls into imported
+units.
+"""
+
+import argparse
+import random
+from pathlib import Path
+
+MODULE_NAME = "bench"
+BINOPS = ["+", "-", "*"]
+
+
+class UnitGenerator:
+    def __init__(self, args, index, rng):
+        self.args = args
+        self.index = index
+        self.rng = rng
+        self.imports = [j for j in range(index + 1, min(index + 1 + args.fanout, args.units))]
+
+    def func_name(self, unit, m):
+        return f"u{unit}_f{m}"
+
+    def entry_name(self, unit):
+        # The last function calls the one before it and so on, so calling it reaches every function of the unit
+        return self.func_name(unit, self.args.functions - 1)
+
+    def leaf(self):
+        choices = ["x", "y", str(self.rng.randint(0, 1000))]
+        if self.args.structs > 0:
+            choices.append("s.a")
+            choices.append("s.b")
+        if self.args.array_size > 0:
+            choices.append(f"arr[{self.rng.randrange(self.args.array_size)}]")
+        return self.rng.choice(choices)
+
+    def expr(self, depth):
+        if depth <= 0:
+            return self.leaf()
+        op = self.rng.choice(BINOPS)
+        return f"({self.expr(depth - 1)} {op} {self.expr(depth - 1)})"
+
+    def function(self, m):
+        lines = [f"func {self.func_name(self.index, m)}(x: int, y: int): int {{"]
+        if self.args.structs > 0:
+            struct = f"U{self.index}S{m % self.args.structs}"
+            lines.append(f"    let s = ~{struct} {{ a: x, b: y, c: {self.rng.randint(0, 100)} }}")
+        if self.args.array_size > 0:
+            values = ", ".join(str(self.rng.randint(0, 1000)) for _ in range(self.args.array_size))
+            lines.append(f"    let arr = ~[{values}]")
+        lines.append(f"    let v: int = {self.expr(self.args.depth)}")
+
+        # Call the previous function in this unit and the first function of each imported unit
+        if m > 0:
+            lines.append(f"    v = v + {self.func_name(self.index, m - 1)}(x, v)")
+        for unit in self.imports:
+            lines.append(f"    v = v + {self.entry_name(unit)}(v, y)")
+
+        lines.append("    let i = 0")
+        lines.append("    while (i < x) {")
+        lines.append(f"        v = v + {self.expr(min(self.args.depth, 2))}")
+        lines.append("        i = i + 1")
+        lines.append("    }")
+        lines.append("    return v")
+        lines.append("}")
+        return "\n".join(lines)
+
+    def generate(self):
+        parts = []
+        for unit in self.imports:
+            parts.append(f"from {MODULE_NAME}.units.u{unit} import {self.entry_name(unit)}")
+        parts.append("")
+        for k in range(self.args.structs):
+            parts.append(f"struct U{self.index}S{k} {{\n    a: int\n    b: int\n    c: long\n}}\n")
+        for m in range(self.args.functions):
+            parts.append(self.function(m) + "\n")
+        return "\n".join(parts)
+
+
+def generate_module(args, out):
+    rng = random.Random(args.seed)
+    (out / "units").mkdir(parents=True, exist_ok=True)
+    (out / "axon.toml").write_text(f'name = "{MODULE_NAME}"\nmain = "{MODULE_NAME}.main"\n')
+
+    for i in range(args.units):
+        (out / "units" / f"u{i}.ax").write_text(UnitGenerator(args, i, rng).generate())
+
+    main = []
+    entry = f"u0_f{args.functions - 1}"
+    if args.units > 0:
+        main.append(f"from {MODULE_NAME}.units.u0 import {entry}")
+    main.append("")
+    main.append("func main(): int {")
+    if args.units > 0:
+        main.append(f"    let r: int = {entry}(1, 2)")
+    main.append("    return 0")
+    main.append("}")
+    (out / "main.ax").write_text("\n".join(main) + "\n")
+
+
+def add_workload_args(parser):
+    parser.add_argument("--units", type=int, default=8, help="number of units (besides main)")
+    parser.add_argument("--fanout", type=int, default=2, help="number of units each unit imports")
+    parser.add_argument("--functions", type=int, default=16, help="functions per unit")
+    parser.add_argument("--depth", type=int, default=4, help="binary expression tree depth")
+    parser.add_argument("--structs", type=int, default=2, help="structs per unit")
+    parser.add_argument("--array-size", type=int, default=16, help="elements per array literal")
+    parser.add_argument("--seed", type=int, default=0)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("out", type=Path, help="directory to generate the module into")
+    add_workload_args(parser)
+    args = parser.parse_args()
+    generate_module(args, args.out)
+
+
+if __name__ == "__main__":
+    main()
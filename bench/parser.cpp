@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ast/ast.h"
+#include "lexer/lexer.h"
+#include "module/generated.h"
+
+// Parser throughput on expression heavy sources: generates a unit full of deep binary expressions, then lexes and
+// parses it repeatedly and reports time and heap allocations of the parse alone (the AST nodes themselves included).
+// Allocation counts are exact, so they're the first thing to compare between builds; times on the default input vary
+// by a few percent from run to run, and a smaller, cache resident input (i.e. 2000 4) shows time differences better.
+//
+// usage: axon_bench_parser [statements] [depth] [iterations]
+
+static std::atomic<size_t> allocations = 0;
+static std::atomic<size_t> allocatedBytes = 0;
+
+void* operator new(const size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+static std::string expression(std::mt19937& rng, const int depth) {
+    static const std::string leaves[] = {"x", "y", "z", "12", "7", "1024"};
+    if (depth <= 0) {
+        return leaves[rng() % std::size(leaves)];
+    }
+    auto op = static_cast<OperatorKind>(rng() % OPERATOR_COUNT);
+    while (!isBinop(op) || op == OP_AND || op == OP_OR) {
+        op = static_cast<OperatorKind>(rng() % OPERATOR_COUNT);
+    }
+    auto expr = expression(rng, depth - 1) + " " + std::string(OPERATOR_STRINGS[op]) + " " +
+                expression(rng, depth - 1);
+    // Mix in parentheses and unary minus so not every expression is a flat chain
+    switch (rng() % 4) {
+        case 0:
+            return "(" + expr + ")";
+        case 1:
+            return "-" + leaves[rng() % std::size(leaves)] + " * " + expr;
+        default:
+            return expr;
+    }
+}
+
+static std::string generate(const int statements, const int depth) {
+    std::mt19937 rng(0);
+    std::string text;
+    constexpr int statementsPerFunction = 100;
+    for (int i = 0; i < statements; i += statementsPerFunction) {
+        text += "func f" + std::to_string(i) + "(x: int, y: int, z: int): int {\n";
+        for (int j = 0; j < statementsPerFunction && i + j < statements; j++) {
+            text += "    let v" + std::to_string(j) + ": int = " + expression(rng, depth) + "\n";
+        }
+        text += "    return x\n}\n\n";
+    }
+    return text;
+}
+
+int main(const int argc, char* argv[]) {
+    const int statements = argc > 1 ? std::stoi(argv[1]) : 10000;
+    const int depth = argc > 2 ? std::stoi(argv[2]) : 6;
+    const int iterations = std::max(argc > 3 ? std::stoi(argv[3]) : 10, 1);
+
+    const auto text = generate(statements, depth);
+
+    std::vector<double> times;
+    size_t parseAllocations = 0;
+    size_t parseBytes = 0;
+    size_t tokens = 0;
+    for (int i = 0; i < iterations; i++) {
+        Lexer lexer(text);
+        tokens = lexer.tokenCount();
+
+        auto allocationsBefore = allocations.load();
+        auto bytesBefore = allocatedBytes.load();
+        auto start = std::chrono::steady_clock::now();
+        auto unit = parseUnit(lexer, "bench.parser");
+        auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (!unit) {
+            std::cerr << lexer.formatParsingError("bench.parser", "<generated>") << std::endl;
+            return 1;
+        }
+        parseAllocations = allocations.load() - allocationsBefore;
+        parseBytes = allocatedBytes.load() - bytesBefore;
+        times.push_back(elapsed);
+    }
+    // The best time is the least noisy on an idle machine, the median is more honest on a busy one
+    std::ranges::sort(times);
+    const double bestMs = times.front();
+    const double medianMs = times[times.size() / 2];
+
+    std::cout << "source: " << text.size() / 1024 << " KiB, " << tokens << " tokens" << std::endl;
+    std::cout << "parse time: " << bestMs << " ms best, " << medianMs << " ms median (" << iterations << " runs)" <<
+            std::endl;
+    std::cout << "throughput: " << tokens / bestMs / 1000 << " M tokens/s" << std::endl;
+    std::cout << "allocations: " << parseAllocations << " (" << static_cast<double>(parseAllocations) / tokens <<
+            " per token)" << std::endl;
+    std::cout << "allocated: " << parseBytes / 1024 << " KiB" << std::endl;
+
+    GeneratedType::free();
+    return 0;
+}
@@ -0,0 +1,12 @@
+#include <stddef.h>
+
+static size_t fib(size_t n) {
+    if (n < 2) {
+        return n;
+    }
+    return fib(n - 1) + fib(n - 2);
+}
+
+size_t reference_run(size_t n) {
+    return fib(n);
+}
@@ -0,0 +1,33 @@
+#include <stddef.h>
+#include <stdlib.h>
+
+typedef struct {
+    size_t value;
+    size_t left;
+    size_t right;
+} Node;
+
+size_t reference_run(size_t n) {
+    // Allocate nodes individually to match Axon's layout
+    Node** nodes = calloc(n, sizeof(Node*));
+    for (size_t i = 0; i < n; i++) {
+        nodes[i] = malloc(sizeof(Node));
+        nodes[i]->value = (i * 31 + 7) % 101;
+        nodes[i]->left = (i * 2 + 1) % n;
+        nodes[i]->right = (i * 5 + 3) % n;
+    }
+
+    size_t total = 0;
+    size_t cur = 0;
+    for (size_t step = 0; step < n * 8; step++) {
+        Node* node = nodes[cur];
+        total += node->value;
+        cur = node->value % 2 == 0 ? node->left : node->right;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        free(nodes[i]);
+    }
+    free(nodes);
+    return total;
+}
@@ -0,0 +1,75 @@
+// Benchmark harness for generated code. Each kernel is linked against this file, its Axon implementation
+// (AXON_KERNEL_SYMBOL) and an equivalent C reference implementation, and both are timed on the same input.
+//
+// usage: harness <n> <repetitions>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef AXON_KERNEL_SYMBOL
+#error "AXON_KERNEL_SYMBOL must be defined"
+#endif
+
+// Axon functions are mangled as module.unit.function, which isn't a valid C identifier
+size_t axon_run(size_t n) __asm__(AXON_KERNEL_SYMBOL);
+
+size_t reference_run(size_t n);
+
+// Axon arrays are {pointer, length} fat pointers; this matches how LLVM lowers them when passed by value
+typedef struct {
+    void* ptr;
+    size_t len;
+} AxonArray;
+
+// Axon can't allocate arrays of a runtime size yet, so kernels get their working memory from here
+AxonArray axon_bench_alloc(size_t n, size_t elementSize) {
+    AxonArray array = {calloc(n, elementSize), n};
+    return array;
+}
+
+size_t axon_bench_len(AxonArray array) {
+    return array.len;
+}
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static double best_time(size_t (*kernel)(size_t), size_t n, int reps, size_t* result) {
+    double best = -1;
+    for (int i = 0; i < reps; i++) {
+        double start = now_ms();
+        *result = kernel(n);
+        double elapsed = now_ms() - start;
+        if (best < 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <n> <repetitions>\n", argv[0]);
+        return 2;
+    }
+    size_t n = strtoull(argv[1], NULL, 10);
+    int reps = atoi(argv[2]);
+
+    size_t axonResult;
+    size_t referenceResult;
+    double axonMs = best_time(axon_run, n, reps, &axonResult);
+    double referenceMs = best_time(reference_run, n, reps, &referenceResult);
+    if (axonResult != referenceResult) {
+        fprintf(stderr, "result mismatch: axon %zu, reference %zu\n", axonResult, referenceResult);
+        return 1;
+    }
+
+    printf("{\"axon_ms\": %f, \"reference_ms\": %f, \"result\": %zu}\n", axonMs, referenceMs, axonResult);
+    return 0;
+}
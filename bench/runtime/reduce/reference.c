@@ -0,0 +1,18 @@
+#include <stddef.h>
+#include <stdlib.h>
+
+size_t reference_run(size_t n) {
+    size_t* data = calloc(n, sizeof(size_t));
+    for (size_t i = 0; i < n; i++) {
+        data[i] = (i * 7 + 3) % 1000;
+    }
+
+    size_t sum = 0;
+    for (size_t pass = 0; pass < 16; pass++) {
+        for (size_t i = 0; i < n; i++) {
+            sum += data[i] * (pass + 1);
+        }
+    }
+    free(data);
+    return sum;
+}
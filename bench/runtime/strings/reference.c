@@ -0,0 +1,24 @@
+#include <stddef.h>
+#include <string.h>
+
+size_t reference_run(size_t n) {
+    // Read through a volatile pointer so the compiler can't constant fold the whole loop away,
+    // which Axon can't do either since the text length comes from an extern call
+    const char* volatile source = "The quick brown fox jumps over the lazy dog; pack my box with five dozen liquor jugs.\n";
+    const char* text = source;
+    size_t length = strlen(text);
+
+    size_t vowels = 0;
+    size_t words = 0;
+    for (size_t pass = 0; pass < n; pass++) {
+        for (size_t i = 0; i < length; i++) {
+            char c = text[i];
+            if (c == 'a' || c == 'e' || c == 'i' || c == 'o' || c == 'u') {
+                vowels++;
+            } else if (c == ' ' || c == '\n') {
+                words++;
+            }
+        }
+    }
+    return vowels * 1000 + words;
+}
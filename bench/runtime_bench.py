@@ -0,0 +1,73 @@
+#!/usr/bin/env python3
+"""Generated code runtime benchmark.
+
+Compiles every kernel in runtime/ at each optimization level, links it against the C harness and the kernel's C
+reference implementation, and reports how long the Axon version takes relative to the reference.
+"""
+
+import argparse
+import json
+import subprocess
+import sys
+from pathlib import Path
+
+ROOT = Path(__file__).parent / "runtime"
+
+# kernel -> input size passed to run(n)
+KERNELS = {
+    "reduce": 1_000_000,
+    "graph": 200_000,
+    "strings": 20_000,
+    "fib": 30,
+}
+
+
+def run(command):
+    result = subprocess.run(command, capture_output=True, text=True)
+    if result.returncode != 0:
+        sys.exit(f"{' '.join(map(str, command))} failed:\n{result.stdout}{result.stderr}")
+    return result.stdout
+
+
+def build(args, kernel, opt_level):
+    out = args.work_dir / kernel / f"O{opt_level}"
+    out.mkdir(parents=True, exist_ok=True)
+    bitcode = out / f"{kernel}.bc"
+    run([args.compiler, ROOT / kernel / "axon.toml", "-O", str(opt_level), "-o", bitcode])
+
+    exe = out / kernel
+    # The reference is always built at -O2 so every opt level is compared against the same baseline
+    run([args.cc, "-O2", f"-DAXON_KERNEL_SYMBOL=\"kernel.{kernel}.run\"", ROOT / "harness.c",
+         ROOT / kernel / "reference.c", bitcode, "-o", exe])
+    return exe
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--compiler", required=True, type=Path)
+    parser.add_argument("--cc", default="clang", help="C compiler used to link (must accept LLVM bitcode)")
+    parser.add_argument("--work-dir", required=True, type=Path)
+    parser.add_argument("--repeat", type=int, default=5, help="runs per kernel; the fastest is kept")
+    parser.add_argument("--opt-levels", default="0,1,2,3")
+    parser.add_argument("--kernel", action="append", choices=KERNELS.keys(), help="only run these kernels")
+    parser.add_argument("--json", type=Path, help="also write the results to this file")
+    args = parser.parse_args()
+
+    results = {}
+    print(f"{'kernel':<10} {'opt':>4} {'axon ms':>10} {'C ms':>10} {'ratio':>7}")
+    for kernel in args.kernel or KERNELS:
+        results[kernel] = {}
+        for opt_level in map(int, args.opt_levels.split(",")):
+            exe = build(args, kernel, opt_level)
+            timing = json.loads(run([exe, str(KERNELS[kernel]), str(args.repeat)]))
+            ratio = timing["axon_ms"] / timing["reference_ms"] if timing["reference_ms"] > 0 else float("inf")
+            results[kernel][f"O{opt_level}"] = dict(timing, ratio=ratio)
+            print(f"{kernel:<10} {'O' + str(opt_level):>4} {timing['axon_ms']:>10.3f} {timing['reference_ms']:>10.3f}"
+                  f" {ratio:>6.2f}x")
+
+    if args.json:
+        args.json.write_text(json.dumps(results, indent=2, sort_keys=True) + "\n")
+
+
+if __name__ == "__main__":
+    main()
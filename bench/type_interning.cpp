@@ -0,0 +1,86 @@
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lexer/lexer.h"
+#include "module/generated.h"
+
+// Stress test for the type interning table: many threads hammer GeneratedType::get with an overlapping
+// set of types, and every thread must end up with the exact same pointer for each type.
+//
+// usage: axon_bench_type_interning [threads] [iterations]
+
+static std::vector<std::string> typeNames() {
+    std::vector<std::string> names;
+    for (const auto& base: TYPES) {
+        names.push_back(base);
+    }
+    for (int i = 0; i < 64; i++) {
+        names.push_back("Struct" + std::to_string(i));
+    }
+
+    auto baseCount = names.size();
+    for (size_t i = 0; i < baseCount; i++) {
+        names.push_back(names[i] + "~");
+        names.push_back(names[i] + "[]");
+        names.push_back(names[i] + "[]~");
+        names.push_back(names[i] + "[][]");
+    }
+    return names;
+}
+
+int main(const int argc, char* argv[]) {
+    const int threadCount = argc > 1 ? std::stoi(argv[1]) : static_cast<int>(std::thread::hardware_concurrency());
+    const int iterations = argc > 2 ? std::stoi(argv[2]) : 20000;
+
+    const auto names = typeNames();
+    std::vector<std::vector<GeneratedType*> > results(threadCount, std::vector<GeneratedType*>(names.size()));
+    std::atomic<bool> start = false;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; t++) {
+        threads.emplace_back([&, t]() {
+            while (!start.load()) {
+                std::this_thread::yield();
+            }
+            for (int i = 0; i < iterations; i++) {
+                // Offset each thread so they race to create different types first
+                auto index = (i + t * 7) % names.size();
+                auto* type = GeneratedType::rawGet(names[index]);
+                // Function types exercise the tuple backer as well
+                GeneratedType::get(TypeBacker(std::make_tuple(std::vector{type, type}, type), false));
+                results[t][index] = type;
+            }
+        });
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+    start = true;
+    for (auto& thread: threads) {
+        thread.join();
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+    for (size_t i = 0; i < names.size(); i++) {
+        auto* expected = GeneratedType::rawGet(names[i]);
+        for (int t = 0; t < threadCount; t++) {
+            if (results[t][i] && results[t][i] != expected) {
+                std::cerr << "Type " << names[i] << " interned twice" << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    // Each iteration performs one rawGet (which may recurse for arrays) and one function type get
+    auto lookups = static_cast<double>(threadCount) * iterations * 2;
+    std::cout << "threads: " << threadCount << std::endl;
+    std::cout << "lookups: " << static_cast<size_t>(lookups) << std::endl;
+    std::cout << "time: " << elapsed * 1000 << " ms" << std::endl;
+    std::cout << "throughput: " << lookups / elapsed / 1e6 << " M lookups/s" << std::endl;
+
+    GeneratedType::free();
+    return 0;
+}
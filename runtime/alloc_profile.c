@@ -0,0 +1,100 @@
+// Allocation profiling runtime for programs built with --alloc-profile.
+// Every allocation made by Axon code (constructors and array literals) goes through __axon_alloc along with the id of
+// its allocation site. Counts and bytes are kept per site and printed at exit, biggest sites first, so it's easy to see
+// which constructors are worth pooling or keeping on the stack.
+//
+// Link it into the program: clang program.bc runtime/alloc_profile.c -o program
+//
+// environment:
+//   AXON_ALLOC_PROFILE_FILE  where to write the report (default: stderr)
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Matches the site table emitted by the compiler
+typedef struct {
+    const char* unit;
+    const char* function;
+    int32_t line;
+    const char* type;
+} AxonAllocSite;
+
+extern const AxonAllocSite __axon_alloc_sites[];
+extern const uint32_t __axon_alloc_site_count;
+
+typedef struct {
+    uint64_t count;
+    uint64_t bytes;
+} SiteStats;
+
+static SiteStats* stats = NULL;
+
+void* __axon_alloc(size_t size, uint32_t site) {
+    // Relaxed atomics keep counting correct for threaded programs without ordering anything
+    __atomic_fetch_add(&stats[site].count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats[site].bytes, size, __ATOMIC_RELAXED);
+    return malloc(size);
+}
+
+static int compare_sites(const void* a, const void* b) {
+    uint64_t bytesA = stats[*(const uint32_t*) a].bytes;
+    uint64_t bytesB = stats[*(const uint32_t*) b].bytes;
+    return bytesA < bytesB ? 1 : bytesA > bytesB ? -1 : 0;
+}
+
+static void write_report(void) {
+    FILE* out = stderr;
+    const char* path = getenv("AXON_ALLOC_PROFILE_FILE");
+    if (path && *path && !(out = fopen(path, "w"))) {
+        perror("axon alloc profile: could not open report file");
+        return;
+    }
+
+    uint32_t* order = malloc(__axon_alloc_site_count * sizeof(uint32_t));
+    if (!order) {
+        return;
+    }
+    for (uint32_t i = 0; i < __axon_alloc_site_count; i++) {
+        order[i] = i;
+    }
+    qsort(order, __axon_alloc_site_count, sizeof(uint32_t), compare_sites);
+
+    uint64_t totalCount = 0;
+    uint64_t totalBytes = 0;
+    fprintf(out, "===== Axon allocation profile =====\n");
+    fprintf(out, "%12s %14s  %s\n", "Count", "Bytes", "Site");
+    for (uint32_t i = 0; i < __axon_alloc_site_count; i++) {
+        const AxonAllocSite* site = &__axon_alloc_sites[order[i]];
+        const SiteStats* siteStats = &stats[order[i]];
+        totalCount += siteStats->count;
+        totalBytes += siteStats->bytes;
+        if (siteStats->count == 0) {
+            continue;
+        }
+        fprintf(out,
+                "%12llu %14llu  %s (%s:%d, %s)\n",
+                (unsigned long long) siteStats->count,
+                (unsigned long long) siteStats->bytes,
+                site->type,
+                site->unit,
+                site->line,
+                site->function);
+    }
+    fprintf(out, "%12llu %14llu  total\n", (unsigned long long) totalCount, (unsigned long long) totalBytes);
+    // Frees aren't instrumented, so nothing is known about how much was live at once
+    fprintf(out, "peak live bytes: not tracked\n");
+
+    free(order);
+    if (out != stderr) {
+        fclose(out);
+    }
+}
+
+__attribute__((constructor)) static void install(void) {
+    stats = calloc(__axon_alloc_site_count ? __axon_alloc_site_count : 1, sizeof(SiteStats));
+    if (!stats) {
+        abort();
+    }
+    atexit(write_report);
+}
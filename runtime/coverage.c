@@ -0,0 +1,55 @@
+// Coverage runtime for programs built with --coverage.
+// The compiler emits one counter per block along with the source range of each block. At exit the counts are appended
+// to a coverage file, one line per block, so several runs accumulate; scripts/coverage_report.py turns them into a
+// per line report.
+//
+// Link it into the program: clang program.bc runtime/coverage.c -o program
+//
+// environment:
+//   AXON_COVERAGE_FILE  where to append the counts (default: axon.cov)
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Matches the region table emitted by the compiler
+typedef struct {
+    const char* file;
+    int32_t startLine;
+    int32_t startColumn;
+    int32_t endLine;
+    int32_t endColumn;
+} AxonCoverageRegion;
+
+extern uint64_t __axon_coverage_counters[];
+extern const AxonCoverageRegion __axon_coverage_regions[];
+extern const uint32_t __axon_coverage_count;
+
+static void write_coverage(void) {
+    const char* path = getenv("AXON_COVERAGE_FILE");
+    if (!path || !*path) {
+        path = "axon.cov";
+    }
+    FILE* out = fopen(path, "a");
+    if (!out) {
+        perror("axon coverage: could not open coverage file");
+        return;
+    }
+    // file, start line:column, end line:column, count
+    for (uint32_t i = 0; i < __axon_coverage_count; i++) {
+        const AxonCoverageRegion* region = &__axon_coverage_regions[i];
+        fprintf(out,
+                "%s\t%d:%d\t%d:%d\t%llu\n",
+                region->file,
+                region->startLine,
+                region->startColumn,
+                region->endLine,
+                region->endColumn,
+                (unsigned long long) __axon_coverage_counters[i]);
+    }
+    fclose(out);
+}
+
+__attribute__((constructor)) static void install(void) {
+    atexit(write_coverage);
+}
@@ -0,0 +1,151 @@
+// Reference tracing runtime for programs built with --instrument-functions.
+// Every function entry and exit is recorded into a ring buffer owned by the calling thread, so recording never takes
+// a lock. The buffers are written out as a Chrome trace (chrome://tracing, Perfetto) when the program exits.
+//
+// Link it into the program: clang program.bc runtime/trace.c -o program
+//
+// environment:
+//   AXON_TRACE_FILE  where to write the trace (default: axon_trace.json)
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+// Emitted by the compiler: the name of every instrumented function, indexed by id
+extern const char* const __axon_func_names[];
+extern const uint32_t __axon_func_count;
+
+// Events per thread; once a buffer is full the oldest events are overwritten
+#ifndef AXON_TRACE_BUFFER_EVENTS
+#define AXON_TRACE_BUFFER_EVENTS (1 << 20)
+#endif
+
+typedef struct {
+    uint64_t timestamp;
+    uint32_t id;
+    uint32_t enter;
+} TraceEvent;
+
+typedef struct ThreadBuffer {
+    TraceEvent events[AXON_TRACE_BUFFER_EVENTS];
+    // Total events ever recorded; the ring position is written % AXON_TRACE_BUFFER_EVENTS
+    uint64_t written;
+    uint64_t tid;
+    struct ThreadBuffer* next;
+} ThreadBuffer;
+
+// Buffers are registered once per thread and kept until exit, so threads that already finished still get dumped
+static pthread_mutex_t buffersMutex = PTHREAD_MUTEX_INITIALIZER;
+static ThreadBuffer* buffers = NULL;
+static uint64_t nextTid = 1;
+
+static _Thread_local ThreadBuffer* threadBuffer = NULL;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static ThreadBuffer* register_thread(void) {
+    ThreadBuffer* buffer = calloc(1, sizeof(ThreadBuffer));
+    if (!buffer) {
+        abort();
+    }
+    pthread_mutex_lock(&buffersMutex);
+    buffer->tid = nextTid++;
+    buffer->next = buffers;
+    buffers = buffer;
+    pthread_mutex_unlock(&buffersMutex);
+    return buffer;
+}
+
+static inline void record(uint32_t id, uint32_t enter) {
+    ThreadBuffer* buffer = threadBuffer;
+    if (__builtin_expect(!buffer, 0)) {
+        buffer = threadBuffer = register_thread();
+    }
+    TraceEvent* event = &buffer->events[buffer->written % AXON_TRACE_BUFFER_EVENTS];
+    event->timestamp = now_ns();
+    event->id = id;
+    event->enter = enter;
+    buffer->written++;
+}
+
+void __axon_func_enter(uint32_t id) {
+    record(id, 1);
+}
+
+void __axon_func_exit(uint32_t id) {
+    record(id, 0);
+}
+
+// Names come from arbitrary (i.e. extern or mangled) symbols, so they're escaped to keep the trace valid JSON
+static void write_json_string(FILE* out, const char* str) {
+    fputc('"', out);
+    for (const unsigned char* c = (const unsigned char*) str; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', out);
+            fputc(*c, out);
+        } else if (*c < 0x20) {
+            fprintf(out, "\\u%04x", *c);
+        } else {
+            fputc(*c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static void write_trace(void) {
+    const char* path = getenv("AXON_TRACE_FILE");
+    if (!path || !*path) {
+        path = "axon_trace.json";
+    }
+    FILE* out = fopen(path, "w");
+    if (!out) {
+        perror("axon trace: could not open trace file");
+        return;
+    }
+
+    // Threads still running during exit may keep writing; their last few events can be torn
+    pthread_mutex_lock(&buffersMutex);
+    long pid = (long) getpid();
+    int first = 1;
+    fprintf(out, "{\"traceEvents\":[\n");
+    for (ThreadBuffer* buffer = buffers; buffer; buffer = buffer->next) {
+        uint64_t count = buffer->written < AXON_TRACE_BUFFER_EVENTS ? buffer->written : AXON_TRACE_BUFFER_EVENTS;
+        uint64_t start = buffer->written - count;
+        for (uint64_t i = start; i < buffer->written; i++) {
+            const TraceEvent* event = &buffer->events[i % AXON_TRACE_BUFFER_EVENTS];
+            const char* name = event->id < __axon_func_count ? __axon_func_names[event->id] : "<unknown>";
+            // Trace timestamps are in microseconds
+            fprintf(out, "%s{\"name\":", first ? "" : ",\n");
+            write_json_string(out, name);
+            fprintf(out,
+                    ",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":%ld,\"tid\":%llu}",
+                    event->enter ? "B" : "E",
+                    event->timestamp / 1000.0,
+                    pid,
+                    (unsigned long long) buffer->tid);
+            first = 0;
+        }
+        if (buffer->written > count) {
+            fprintf(stderr,
+                    "axon trace: thread %llu overflowed its buffer, the oldest %llu events were dropped\n",
+                    (unsigned long long) buffer->tid,
+                    (unsigned long long) (buffer->written - count));
+        }
+    }
+    fprintf(out, "\n]}\n");
+    pthread_mutex_unlock(&buffersMutex);
+    fclose(out);
+}
+
+__attribute__((constructor)) static void install(void) {
+    atexit(write_trace);
+}
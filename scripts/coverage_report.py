@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+"""Coverage report for Axon programs built with --coverage.
+
+Reads the coverage files written by runtime/coverage.c (counts of the same block from several runs or files are summed)
+and prints, per source file, how many blocks and lines ran. Each line is attributed to the innermost block containing
+it. With --annotate the source is printed gcov style, with the execution count of every line and ##### for lines that
+never ran.
+"""
+
+import argparse
+from collections import defaultdict
+from pathlib import Path
+
+
+def read_counts(paths):
+    # (file, start, end) -> count
+    counts = defaultdict(int)
+    for path in paths:
+        for line in path.read_text().splitlines():
+            file, start, end, count = line.split("\t")
+            start = tuple(map(int, start.split(":")))
+            end = tuple(map(int, end.split(":")))
+            counts[(file, start, end)] += int(count)
+    return counts
+
+
+def line_counts(regions, source):
+    # Inner blocks are contained in outer ones, so the smallest region containing a line is the one it belongs to
+    lines = {}
+    for (start, end), count in sorted(regions.items(), key=lambda region: region[0][1][0] - region[0][0][0],
+                                      reverse=True):
+        first = start[0]
+        # A block opening after other code (e.g. `if (x) {`) leaves that line to the enclosing block
+        if first <= len(source) and source[first - 1][:start[1] - 1].strip():
+            first += 1
+        for line in range(first, end[0] + 1):
+            lines[line] = count
+    # Blank lines and comments aren't code
+    for number, text in enumerate(source, start=1):
+        if not text.strip() or text.strip().startswith("//"):
+            lines.pop(number, None)
+    return lines
+
+
+def format_ranges(lines):
+    ranges = []
+    for line in sorted(lines):
+        if ranges and ranges[-1][1] == line - 1:
+            ranges[-1][1] = line
+        else:
+            ranges.append([line, line])
+    return ", ".join(str(a) if a == b else f"{a}-{b}" for a, b in ranges)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("coverage", nargs="+", type=Path, help="coverage files (axon.cov)")
+    parser.add_argument("--annotate", action="store_true", help="print every source file with per line counts")
+    args = parser.parse_args()
+
+    files = defaultdict(dict)
+    for (file, start, end), count in read_counts(args.coverage).items():
+        files[file][(start, end)] = count
+
+    for file in sorted(files):
+        regions = files[file]
+        source = Path(file).read_text().splitlines() if Path(file).exists() else []
+        lines = line_counts(regions, source)
+        covered_regions = sum(1 for count in regions.values() if count > 0)
+        covered_lines = sum(1 for count in lines.values() if count > 0)
+        print(f"== {file}: {covered_regions}/{len(regions)} blocks, {covered_lines}/{len(lines)} lines")
+        never = [line for line, count in lines.items() if count == 0]
+        if never:
+            print(f"   never ran: lines {format_ranges(never)}")
+
+        if args.annotate:
+            for number, text in enumerate(source, start=1):
+                count = lines.get(number)
+                mark = "-" if count is None else "#####" if count == 0 else str(count)
+                print(f"{mark:>10}: {number:>5}: {text}")
+
+
+if __name__ == "__main__":
+    main()
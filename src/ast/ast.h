@@ -1,14 +1,20 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
 #include <optional>
 #include <ranges>
 #include <vector>
 #include <unordered_map>
 
+#include "ast/builtins.h"
+#include "lexer/operators.h"
+
 namespace llvm {
+    class Function;
     class Value;
     class Type;
+    class StructType;
 }
 
 using namespace llvm;
@@ -41,6 +47,16 @@ public:
     void setDebugInfo(const DebugInfo& debugInfo) {
         this->debugInfo = debugInfo;
     }
+
+    // All nodes are allocated through here so --mem-report can account for AST memory. Only the nodes themselves are
+    // counted, not the strings and vectors they own.
+    static void* operator new(size_t size);
+
+    static void operator delete(void* ptr, size_t size);
+
+    static size_t liveNodes();
+
+    static size_t liveBytes();
 };
 
 class TopLevelAST : virtual public AST {
@@ -59,28 +75,82 @@ class ExprAST : virtual public StatementAST {
 public:
     bool codegen(ModuleState& state) override;
 
+    // Whether the expression consists only of number and bool literals, i.e. its value is known at compile time and
+    // evaluating it has no side effects
+    virtual bool isConstant() {
+        return false;
+    }
+
     // impliedType is necessary for empty arrays and number values, but we don't do any checking on it
     // (it is purely for implicit casts, which should also be relatively rare)
     virtual std::unique_ptr<GeneratedValue> codegenValue(ModuleState& state, GeneratedType* impliedType) = 0;
 };
 
 class AssignableAST : virtual public ExprAST {
+protected:
+    // Loads the value a pointer from codegenPointer points to
+    static std::unique_ptr<GeneratedValue> load(ModuleState& state, std::unique_ptr<GeneratedValue> pointer);
+
+    // Codegens the value an assignment stores into targetType: valueExpr, combined with current for compound operators
+    static std::unique_ptr<GeneratedValue> codegenAssignedValue(ModuleState& state,
+                                                                const DebugInfo& debugInfo,
+                                                                OperatorKind op,
+                                                                GeneratedType* targetType,
+                                                                GeneratedValue* current,
+                                                                ExprAST* valueExpr);
+
+    // Assigns valueExpr to what pointer points to
+    static bool codegenStore(ModuleState& state,
+                             const DebugInfo& debugInfo,
+                             OperatorKind op,
+                             std::unique_ptr<GeneratedValue> pointer,
+                             ExprAST* valueExpr);
+
 public:
     std::unique_ptr<GeneratedValue> codegenValue(ModuleState& state, GeneratedType* impliedType) override;
 
     virtual std::unique_ptr<GeneratedValue> codegenPointer(ModuleState& state) = 0;
+
+    // Assigns valueExpr to this (op being OP_ASSIGN or a compound assignment operator)
+    virtual bool codegenAssign(ModuleState& state, const DebugInfo& debugInfo, OperatorKind op, ExprAST* valueExpr);
 };
 
 // expr
+enum LiteralKind {
+    LITERAL_STRING,
+    LITERAL_BOOL,
+    LITERAL_INT,
+    LITERAL_FLOAT,
+};
+
+// A literal as decoded by the parser; its type is only decided at codegen, from the implied type
+struct Literal {
+    LiteralKind kind;
+    // Unescaped contents of string literals
+    std::string string;
+    // Magnitude of integer literals, or 0/1 for bools
+    uint64_t integer = 0;
+    double floating = 0;
+    // Set when a minus sign was folded into a number literal
+    bool negative = false;
+};
+
 class ValueExprAST : public ExprAST {
     std::string rawValue;
+    Literal literal;
 
 public:
-    explicit ValueExprAST(std::string rawValue): rawValue(std::move(rawValue)) {
+    explicit ValueExprAST(std::string rawValue, Literal literal): rawValue(std::move(rawValue)),
+                                                                   literal(std::move(literal)) {
     }
 
     std::string toString() override;
 
+    bool isConstant() override;
+
+    // Folds a minus sign into a number literal; returns false for other literals
+    bool negate();
+
     std::unique_ptr<GeneratedValue> codegenValue(ModuleState& state, GeneratedType* impliedType) override;
 };
 
@@ -100,43 +170,64 @@ public:
 class BinaryOpExprAST : public ExprAST {
     std::unique_ptr<ExprAST> LHS;
     std::unique_ptr<ExprAST> RHS;
-    std::string binOp;
+    OperatorKind binOp;
 
 public:
     explicit BinaryOpExprAST(std::unique_ptr<ExprAST> LHS,
                              std::unique_ptr<ExprAST> RHS,
-                             std::string binOp): LHS(std::move(LHS)), RHS(std::move(RHS)), binOp(std::move(binOp)) {
+                             const OperatorKind binOp): LHS(std::move(LHS)), RHS(std::move(RHS)), binOp(binOp) {
     }
 
     std::string toString() override;
 
+    bool isConstant() override;
+
     std::unique_ptr<GeneratedValue> codegenValue(ModuleState& state, GeneratedType* impliedType) override;
+
+    // Emits the operation on two already generated values (also used for compound assignments). Operations on two
+    // integer constants are evaluated right away, and overflow or division by zero is reported as an error.
+    static std::unique_ptr<GeneratedValue> codegenOp(ModuleState& state,
+                                                     const DebugInfo& debugInfo,
+                                                     OperatorKind binOp,
+                                                     const GeneratedValue* L,
+                                                     const GeneratedValue* R);
 };
 
 class UnaryOpExprAST : public ExprAST {
     std::unique_ptr<ExprAST> expr;
-    std::string unaryOp;
+    OperatorKind unaryOp;
 
 public:
-    explicit UnaryOpExprAST(std::unique_ptr<ExprAST> expr, std::string unaryOp): expr(std::move(expr)),
-        unaryOp(std::move(unaryOp)) {
+    explicit UnaryOpExprAST(std::unique_ptr<ExprAST> expr, const OperatorKind unaryOp): expr(std::move(expr)),
+        unaryOp(unaryOp) {
     }
 
     std::string toString() override;
 
+    bool isConstant() override;
+
     std::unique_ptr<GeneratedValue> codegenValue(ModuleState& state, GeneratedType* impliedType) override;
 };
 
 class CallExprAST : public ExprAST {
+    // Null for builtin calls
     std::unique_ptr<ExprAST> callee;
+    BuiltinKind builtin = BUILTIN_NONE;
     std::vector<std::unique_ptr<ExprAST> > args;
 
+    // Defined in ast_builtins.cpp
+    std::unique_ptr<GeneratedValue> codegenBuiltin(ModuleState& state, GeneratedType* impliedType);
+
 public:
     explicit CallExprAST(std::unique_ptr<ExprAST> callee,
                          std::vector<std::unique_ptr<ExprAST> > args): callee(std::move(callee)),
                                                                        args(std::move(args)) {
     }
 
+    explicit CallExprAST(const BuiltinKind builtin,
+                         std::vector<std::unique_ptr<ExprAST> > args): builtin(builtin), args(std::move(args)) {
+    }
+
     std::string toString() override;
 
     std::unique_ptr<GeneratedValue> codegenValue(ModuleState& state, GeneratedType* impliedType) override;
@@ -146,6 +237,8 @@ class MemberAccessExprAST : public AssignableAST {
     std::unique_ptr<ExprAST> structExpr;
     std::string fieldName;
 
+    std::unique_ptr<GeneratedValue> codegenFieldPointer(ModuleState& state, std::unique_ptr<GeneratedValue> structVal);
+
 public:
     explicit MemberAccessExprAST(std::unique_ptr<ExprAST> structExpr,
                                  std::string fieldName): structExpr(std::move(structExpr)),
@@ -154,13 +247,20 @@ public:
 
     std::string toString() override;
 
+    std::unique_ptr<GeneratedValue> codegenValue(ModuleState& state, GeneratedType* impliedType) override;
+
     std::unique_ptr<GeneratedValue> codegenPointer(ModuleState& state) override;
 };
 
+// Indexes arrays, and lanes of vectors
 class SubscriptExprAST : public AssignableAST {
     std::unique_ptr<ExprAST> arrayExpr;
     std::unique_ptr<ExprAST> indexExpr;
 
+    std::unique_ptr<GeneratedValue> codegenIndex(ModuleState& state, GeneratedType* indexedType);
+
+    std::unique_ptr<GeneratedValue> codegenElementPointer(ModuleState& state, std::unique_ptr<GeneratedValue> arrayVal);
+
 public:
     explicit SubscriptExprAST(std::unique_ptr<ExprAST> arrayExpr,
                               std::unique_ptr<ExprAST> indexExpr): arrayExpr(std::move(arrayExpr)),
@@ -169,7 +269,32 @@ public:
 
     std::string toString() override;
 
+    std::unique_ptr<GeneratedValue> codegenValue(ModuleState& state, GeneratedType* impliedType) override;
+
     std::unique_ptr<GeneratedValue> codegenPointer(ModuleState& state) override;
+
+    bool codegenAssign(ModuleState& state, const DebugInfo& debugInfo, OperatorKind op, ExprAST* valueExpr) override;
+};
+
+// arr[start:end] borrows elements [start, end) of an array in place; either bound can be left out
+class SliceExprAST : public ExprAST {
+    std::unique_ptr<ExprAST> arrayExpr;
+    std::unique_ptr<ExprAST> startExpr;
+    std::unique_ptr<ExprAST> endExpr;
+
+    std::unique_ptr<GeneratedValue> codegenBound(ModuleState& state, const std::unique_ptr<ExprAST>& boundExpr);
+
+public:
+    explicit SliceExprAST(std::unique_ptr<ExprAST> arrayExpr,
+                          std::unique_ptr<ExprAST> startExpr,
+                          std::unique_ptr<ExprAST> endExpr): arrayExpr(std::move(arrayExpr)),
+                                                             startExpr(std::move(startExpr)),
+                                                             endExpr(std::move(endExpr)) {
+    }
+
+    std::string toString() override;
+
+    std::unique_ptr<GeneratedValue> codegenValue(ModuleState& state, GeneratedType* impliedType) override;
 };
 
 class ConstructorExprAST : public ExprAST {
@@ -216,6 +341,9 @@ public:
 
     bool preregister(ModuleState& state, const std::string& unit) override;
 
+    // Registers the imported names as struct names of unit, once the imported unit's types are registered
+    bool registerTypes(ModuleState& state, const std::string& unit);
+
     bool postregister(ModuleState& state, const std::string& unit) override;
 
     bool codegen(ModuleState& state) override;
@@ -240,6 +368,8 @@ public:
     bool isExtern;
     // Only allowed for extern functions!
     bool hasVarArgs;
+    // Exported functions are codegen roots, i.e. callable from outside the module
+    bool isExported = false;
 
     explicit FuncAST(
         std::vector<SigArg> signature,
@@ -266,22 +396,39 @@ public:
     bool postregister(ModuleState& state, const std::string& unit) override;
 
     bool codegen(ModuleState& state) override;
+
+private:
+    // Attaches facts the frontend knows but LLVM can't easily infer on its own
+    void addInferredAttributes(ModuleState& state, Function* function);
 };
 
 class StructAST : public TopLevelAST {
     std::string structName;
     std::vector<std::tuple<std::string, GeneratedType*> > fields;
     std::unordered_map<std::string, std::unique_ptr<FuncAST> > methods;
+    // Inline (value) structs are stored by value in variables, fields and arrays instead of behind a pointer
+    bool isInline;
+
+    StructType* structType = nullptr;
 
 public:
+    // Methods of exported structs are codegen roots
+    bool isExported = false;
+
     explicit StructAST(std::string structName,
                        std::vector<std::tuple<std::string, GeneratedType*> > fields,
-                       std::unordered_map<std::string, std::unique_ptr<FuncAST> > methods
-    ): structName(std::move(structName)), fields(std::move(fields)), methods(std::move(methods)) {
+                       std::unordered_map<std::string, std::unique_ptr<FuncAST> > methods,
+                       const bool isInline
+    ): structName(std::move(structName)), fields(std::move(fields)), methods(std::move(methods)),
+       isInline(isInline) {
     }
 
     std::string toString() override;
 
+    // Creates the (still empty) LLVM struct type. Runs for every unit before anything is preregistered, since
+    // declarations anywhere can hold inline structs by value and need their type.
+    bool registerType(ModuleState& state, const std::string& unit);
+
     bool preregister(ModuleState& state, const std::string& unit) override;
 
     bool postregister(ModuleState& state, const std::string& unit) override;
@@ -294,18 +441,18 @@ class VarAST : public TopLevelAST, public StatementAST {
     bool definition;
     std::unique_ptr<AssignableAST> variableExpr;
     std::optional<GeneratedType*> type;
-    std::string varOp;
+    OperatorKind varOp;
     std::unique_ptr<ExprAST> expr;
 
 public:
     explicit VarAST(const bool definition,
                     std::unique_ptr<AssignableAST> variableExpr,
                     std::optional<GeneratedType*> type,
-                    std::string varOp,
+                    const OperatorKind varOp,
                     std::unique_ptr<ExprAST> expr): definition(definition),
                                                     variableExpr(std::move(variableExpr)),
                                                     type(std::move(type)),
-                                                    varOp(std::move(varOp)),
+                                                    varOp(varOp),
                                                     expr(std::move(expr)) {
     }
 
@@ -387,9 +534,15 @@ public:
 
     std::string toString() override;
 
+    // Registers imports and struct types; see StructAST::registerType
+    bool registerTypes(ModuleState& state);
+
     bool preregisterUnit(ModuleState& state);
 
     bool codegen(ModuleState& state) override;
+
+    // Codegens the function bodies of this unit that became reachable since it was last codegenned
+    bool codegenQueued(ModuleState& state);
 };
 
 // parsing funcs
@@ -407,6 +560,8 @@ std::unique_ptr<VarAST> parseVar(Lexer& lexer);
 
 std::unique_ptr<CallExprAST> parseCall(Lexer& lexer, std::unique_ptr<ExprAST> callee);
 
+std::unique_ptr<CallExprAST> parseBuiltin(Lexer& lexer);
+
 template<std::derived_from<ExprAST> T>
 std::unique_ptr<T> parseAccessor(Lexer& lexer, std::unique_ptr<T> expr);
 
@@ -0,0 +1,536 @@
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Intrinsics.h>
+
+#include "ast.h"
+#include "lexer/lexer.h"
+#include "module/generated.h"
+#include "module/module_state.h"
+
+static std::string builtinName(const BuiltinKind builtin) {
+    return KW_BUILTIN + "." + std::string(BUILTIN_NAMES[builtin]);
+}
+
+static bool checkArgCount(ModuleState& state,
+                          const DebugInfo& debugInfo,
+                          const BuiltinKind builtin,
+                          const size_t got,
+                          const size_t expected) {
+    if (got != expected) {
+        state.setError(debugInfo,
+                       builtinName(builtin) + " expects " + std::to_string(expected) + " arguments, got " +
+                       std::to_string(got));
+        return false;
+    }
+    return true;
+}
+
+// Vectors must also be spellable as types, so builtins only produce lane counts a vector type can have
+static bool isValidLaneCount(const size_t lanes) {
+    return lanes >= 2 && lanes <= MAX_VECTOR_LANES && (lanes & (lanes - 1)) == 0;
+}
+
+// Generates all arguments as one type, since the intrinsics behind most builtins take operands of a single type. The
+// first argument that isn't a constant decides the type, so i.e. builtin.min(0, x) works for any number type x;
+// constants emit no code, so generating it first doesn't change the order of evaluation.
+static bool codegenUniformArgs(ModuleState& state,
+                               const DebugInfo& debugInfo,
+                               const BuiltinKind builtin,
+                               const std::vector<std::unique_ptr<ExprAST> >& args,
+                               GeneratedType* impliedType,
+                               std::vector<std::unique_ptr<GeneratedValue> >& values) {
+    values.resize(args.size());
+    size_t first = 0;
+    while (first + 1 < args.size() && args[first]->isConstant()) {
+        first++;
+    }
+    values[first] = args[first]->codegenValue(state, impliedType);
+    if (!values[first]) {
+        return false;
+    }
+    auto* type = values[first]->type;
+    for (size_t i = 0; i < args.size(); i++) {
+        if (i != first) {
+            values[i] = args[i]->codegenValue(state, type);
+            if (!values[i]) {
+                return false;
+            }
+        }
+        if (values[i]->type != type) {
+            state.setError(debugInfo,
+                           builtinName(builtin) + " expects arguments of the same type, got " + type->toString() +
+                           " and " + values[i]->type->toString());
+            return false;
+        }
+    }
+    return true;
+}
+
+static std::unique_ptr<GeneratedValue> codegenBits(ModuleState& state,
+                                                   const DebugInfo& debugInfo,
+                                                   const BuiltinKind builtin,
+                                                   const std::vector<std::unique_ptr<ExprAST> >& args,
+                                                   GeneratedType* impliedType) {
+    auto isRotate = builtin == BUILTIN_ROTL || builtin == BUILTIN_ROTR;
+    if (!checkArgCount(state, debugInfo, builtin, args.size(), isRotate ? 2 : 1)) {
+        return nullptr;
+    }
+    std::vector<std::unique_ptr<GeneratedValue> > values;
+    if (!codegenUniformArgs(state, debugInfo, builtin, args, impliedType, values)) {
+        return nullptr;
+    }
+    auto* type = values[0]->type;
+    auto* llvmType = type->getLLVMType(state);
+    if (!type->getScalarType()->isNumber() ||
+        (builtin == BUILTIN_BSWAP && llvmType->getScalarSizeInBits() % 16 != 0)) {
+        return state.setError(debugInfo, builtinName(builtin) + " is not defined for " + type->toString());
+    }
+
+    auto* x = values[0]->value;
+    Value* result;
+    switch (builtin) {
+        case BUILTIN_POPCOUNT:
+            result = state.builder->CreateUnaryIntrinsic(Intrinsic::ctpop, x);
+            break;
+        case BUILTIN_CTLZ:
+        case BUILTIN_CTTZ:
+            // Zero is defined to give the bit width, so the result never depends on the target
+            result = state.builder->CreateBinaryIntrinsic(builtin == BUILTIN_CTLZ ? Intrinsic::ctlz : Intrinsic::cttz,
+                                                          x,
+                                                          state.builder->getFalse());
+            break;
+        case BUILTIN_BSWAP:
+            result = state.builder->CreateUnaryIntrinsic(Intrinsic::bswap, x);
+            break;
+        case BUILTIN_ROTL:
+        case BUILTIN_ROTR:
+            // A funnel shift of a value with itself is a rotate, and the shift amount is taken modulo the bit width
+            result = state.builder->CreateIntrinsic(builtin == BUILTIN_ROTL ? Intrinsic::fshl : Intrinsic::fshr,
+                                                    {llvmType},
+                                                    {x, x, values[1]->value});
+            break;
+        default:
+            assert(false && "not a bit builtin");
+            return nullptr;
+    }
+    return std::make_unique<GeneratedValue>(type, result);
+}
+
+static std::unique_ptr<GeneratedValue> codegenMath(ModuleState& state,
+                                                   const DebugInfo& debugInfo,
+                                                   const BuiltinKind builtin,
+                                                   const std::vector<std::unique_ptr<ExprAST> >& args,
+                                                   GeneratedType* impliedType) {
+    size_t argCount = builtin == BUILTIN_FMA ? 3 : builtin == BUILTIN_MIN || builtin == BUILTIN_MAX ? 2 : 1;
+    if (!checkArgCount(state, debugInfo, builtin, args.size(), argCount)) {
+        return nullptr;
+    }
+    std::vector<std::unique_ptr<GeneratedValue> > values;
+    if (!codegenUniformArgs(state, debugInfo, builtin, args, impliedType, values)) {
+        return nullptr;
+    }
+    auto* type = values[0]->type;
+    auto isFloating = type->getScalarType()->isFloating();
+    auto isSigned = type->getScalarType()->isSigned();
+    auto isNumber = type->getScalarType()->isNumber();
+    auto defined = builtin == BUILTIN_SQRT || builtin == BUILTIN_FMA
+                       ? isFloating
+                       : builtin == BUILTIN_ABS
+                             ? isFloating || isSigned
+                             : isFloating || isNumber;
+    if (!defined) {
+        return state.setError(debugInfo, builtinName(builtin) + " is not defined for " + type->toString());
+    }
+
+    Value* result;
+    switch (builtin) {
+        case BUILTIN_SQRT:
+            result = state.builder->CreateUnaryIntrinsic(Intrinsic::sqrt, values[0]->value);
+            break;
+        case BUILTIN_FMA:
+            result = state.builder->CreateIntrinsic(Intrinsic::fma,
+                                                    {type->getLLVMType(state)},
+                                                    {values[0]->value, values[1]->value, values[2]->value});
+            break;
+        case BUILTIN_MIN:
+            result = state.builder->CreateBinaryIntrinsic(
+                isFloating ? Intrinsic::minnum : isSigned ? Intrinsic::smin : Intrinsic::umin,
+                values[0]->value,
+                values[1]->value);
+            break;
+        case BUILTIN_MAX:
+            result = state.builder->CreateBinaryIntrinsic(
+                isFloating ? Intrinsic::maxnum : isSigned ? Intrinsic::smax : Intrinsic::umax,
+                values[0]->value,
+                values[1]->value);
+            break;
+        case BUILTIN_ABS:
+            // The absolute value of the minimum stays the minimum instead of being poison
+            result = isFloating
+                         ? state.builder->CreateUnaryIntrinsic(Intrinsic::fabs, values[0]->value)
+                         : state.builder->CreateBinaryIntrinsic(Intrinsic::abs,
+                                                                values[0]->value,
+                                                                state.builder->getFalse());
+            break;
+        default:
+            assert(false && "not a math builtin");
+            return nullptr;
+    }
+    return std::make_unique<GeneratedValue>(type, result);
+}
+
+static std::unique_ptr<GeneratedValue> codegenArrayArg(ModuleState& state,
+                                                       const DebugInfo& debugInfo,
+                                                       const BuiltinKind builtin,
+                                                       const std::unique_ptr<ExprAST>& arg) {
+    auto array = arg->codegenValue(state, nullptr);
+    if (!array) {
+        return nullptr;
+    }
+    if (!array->type->isArray()) {
+        return state.setError(debugInfo, builtinName(builtin) + " expects an array, got " + array->type->toString());
+    }
+    return array;
+}
+
+static std::unique_ptr<GeneratedValue> codegenMemory(ModuleState& state,
+                                                     const DebugInfo& debugInfo,
+                                                     const BuiltinKind builtin,
+                                                     const std::vector<std::unique_ptr<ExprAST> >& args) {
+    if (!checkArgCount(state, debugInfo, builtin, args.size(), 2)) {
+        return nullptr;
+    }
+    auto array = codegenArrayArg(state, debugInfo, builtin, args[0]);
+    if (!array) {
+        return nullptr;
+    }
+    auto* elementTy = array->type->getArrayBase()->getLLVMType(state);
+    auto alignment = state.dl->getABITypeAlign(elementTy);
+    auto* elementSize = ConstantInt::get(state.sizeTy, state.dl->getTypeAllocSize(elementTy));
+    auto* data = state.builder->CreateExtractValue(array->value, {0}, "arr_ptr");
+    auto* size = state.builder->CreateExtractValue(array->value, {1}, "arr_size");
+    auto* voidType = GeneratedType::rawGet(KW_VOID);
+
+    switch (builtin) {
+        case BUILTIN_MEMCPY:
+        case BUILTIN_MEMMOVE: {
+            auto source = codegenArrayArg(state, debugInfo, builtin, args[1]);
+            if (!source) {
+                return nullptr;
+            }
+            if (source->type->getArrayBase() != array->type->getArrayBase()) {
+                return state.setError(debugInfo,
+                                      builtinName(builtin) + " expects arrays of the same type, got " +
+                                      array->type->toString() + " and " + source->type->toString());
+            }
+            // Copies as many elements as fit, so the copy never goes past either array
+            auto* sourceData = state.builder->CreateExtractValue(source->value, {0}, "arr_ptr");
+            auto* sourceSize = state.builder->CreateExtractValue(source->value, {1}, "arr_size");
+            auto* count = state.builder->CreateBinaryIntrinsic(Intrinsic::umin, size, sourceSize);
+            auto* bytes = state.builder->CreateMul(count, elementSize, "copy_bytes");
+            auto* copy = builtin == BUILTIN_MEMCPY
+                             ? state.builder->CreateMemCpy(data, alignment, sourceData, alignment, bytes)
+                             : state.builder->CreateMemMove(data, alignment, sourceData, alignment, bytes);
+            return std::make_unique<GeneratedValue>(voidType, copy);
+        }
+        case BUILTIN_MEMSET: {
+            auto* byteType = GeneratedType::rawGet(KW_UBYTE);
+            auto byte = args[1]->codegenValue(state, byteType);
+            if (!byte) {
+                return nullptr;
+            }
+            if (byte->type != byteType) {
+                return state.setError(debugInfo,
+                                      builtinName(builtin) + " expects a ubyte value, got " + byte->type->toString());
+            }
+            auto* bytes = state.builder->CreateMul(size, elementSize, "set_bytes");
+            auto* set = state.builder->CreateMemSet(data, byte->value, bytes, alignment);
+            return std::make_unique<GeneratedValue>(voidType, set);
+        }
+        case BUILTIN_PREFETCH: {
+            auto* indexType = GeneratedType::rawGet(KW_USIZE);
+            auto index = args[1]->codegenValue(state, indexType);
+            if (!index) {
+                return nullptr;
+            }
+            if (index->type != indexType) {
+                return state.setError(debugInfo,
+                                      builtinName(builtin) + " expects a usize index, got " + index->type->toString());
+            }
+            auto element = array->getArrayPointer(state, index);
+            // Read access, kept in all cache levels, data cache
+            auto* prefetch = state.builder->CreateIntrinsic(Intrinsic::prefetch,
+                                                            {element->value->getType()},
+                                                            {
+                                                                element->value,
+                                                                state.builder->getInt32(0),
+                                                                state.builder->getInt32(3),
+                                                                state.builder->getInt32(1)
+                                                            });
+            return std::make_unique<GeneratedValue>(voidType, prefetch);
+        }
+        default:
+            assert(false && "not a memory builtin");
+            return nullptr;
+    }
+}
+
+static std::unique_ptr<GeneratedValue> codegenExpect(ModuleState& state,
+                                                     const DebugInfo& debugInfo,
+                                                     const std::vector<std::unique_ptr<ExprAST> >& args,
+                                                     GeneratedType* impliedType) {
+    if (!checkArgCount(state, debugInfo, BUILTIN_EXPECT, args.size(), 2)) {
+        return nullptr;
+    }
+    std::vector<std::unique_ptr<GeneratedValue> > values;
+    if (!codegenUniformArgs(state, debugInfo, BUILTIN_EXPECT, args, impliedType, values)) {
+        return nullptr;
+    }
+    auto* type = values[0]->type;
+    if (!type->isNumber() && !type->isBool()) {
+        return state.setError(debugInfo, builtinName(BUILTIN_EXPECT) + " is not defined for " + type->toString());
+    }
+    if (!isa<ConstantInt>(values[1]->value)) {
+        return state.setError(debugInfo, builtinName(BUILTIN_EXPECT) + " expects a constant expected value");
+    }
+    auto* expect = state.builder->CreateIntrinsic(Intrinsic::expect,
+                                                  {type->getLLVMType(state)},
+                                                  {values[0]->value, values[1]->value});
+    return std::make_unique<GeneratedValue>(type, expect);
+}
+
+static std::unique_ptr<GeneratedValue> codegenSplat(ModuleState& state,
+                                                    const DebugInfo& debugInfo,
+                                                    const std::vector<std::unique_ptr<ExprAST> >& args,
+                                                    GeneratedType* impliedType) {
+    if (!checkArgCount(state, debugInfo, BUILTIN_SPLAT, args.size(), 1)) {
+        return nullptr;
+    }
+    // The lane count can't be written in the call, so it comes from where the result goes
+    if (!impliedType || !impliedType->isVector()) {
+        return state.setError(debugInfo, builtinName(BUILTIN_SPLAT) + " can only be used where a vector is expected");
+    }
+    auto* elementType = impliedType->getVectorElement();
+    auto scalar = args[0]->codegenValue(state, elementType);
+    if (!scalar) {
+        return nullptr;
+    }
+    if (scalar->type != elementType) {
+        return state.setError(debugInfo,
+                              builtinName(BUILTIN_SPLAT) + " to " + impliedType->toString() + " expects " +
+                              elementType->toString() + ", got " + scalar->type->toString());
+    }
+    auto* splat = state.builder->CreateVectorSplat(impliedType->getVectorLanes(), scalar->value, "splat");
+    return std::make_unique<GeneratedValue>(impliedType, splat);
+}
+
+static std::unique_ptr<GeneratedValue> codegenShuffle(ModuleState& state,
+                                                      const DebugInfo& debugInfo,
+                                                      const std::vector<std::unique_ptr<ExprAST> >& args) {
+    if (args.size() < 3) {
+        return state.setError(debugInfo, builtinName(BUILTIN_SHUFFLE) + " expects a vector and at least 2 lanes");
+    }
+    auto first = args[0]->codegenValue(state, nullptr);
+    if (!first) {
+        return nullptr;
+    }
+    if (!first->type->isVector()) {
+        return state.setError(debugInfo,
+                              builtinName(BUILTIN_SHUFFLE) + " expects a vector, got " + first->type->toString());
+    }
+
+    // An optional second vector of the same type; its lanes are numbered after the first vector's. Lanes are always
+    // constants, so a non constant second argument has to be the vector.
+    Value* second = PoisonValue::get(first->type->getLLVMType(state));
+    size_t lanesStart = 1;
+    auto lanesIn = first->type->getVectorLanes();
+    if (!args[1]->isConstant()) {
+        auto secondVal = args[1]->codegenValue(state, first->type);
+        if (!secondVal) {
+            return nullptr;
+        }
+        if (secondVal->type != first->type) {
+            return state.setError(debugInfo,
+                                  builtinName(BUILTIN_SHUFFLE) + " expects two vectors of the same type, got " +
+                                  first->type->toString() + " and " + secondVal->type->toString());
+        }
+        second = secondVal->value;
+        lanesStart = 2;
+        lanesIn *= 2;
+    }
+
+    SmallVector<int> mask;
+    for (size_t i = lanesStart; i < args.size(); i++) {
+        auto lane = args[i]->codegenValue(state, GeneratedType::rawGet(KW_USIZE));
+        if (!lane) {
+            return nullptr;
+        }
+        auto* constantLane = dyn_cast<ConstantInt>(lane->value);
+        if (!constantLane || lane->type != GeneratedType::rawGet(KW_USIZE)) {
+            return state.setError(debugInfo, builtinName(BUILTIN_SHUFFLE) + " lanes must be constant usize values");
+        }
+        if (constantLane->getValue().uge(lanesIn)) {
+            return state.setError(debugInfo,
+                                  "Lane " + std::to_string(constantLane->getZExtValue()) + " out of range for " +
+                                  builtinName(BUILTIN_SHUFFLE) + " of " + std::to_string(lanesIn) + " lanes");
+        }
+        mask.push_back(static_cast<int>(constantLane->getZExtValue()));
+    }
+    if (!isValidLaneCount(mask.size())) {
+        return state.setError(debugInfo,
+                              builtinName(BUILTIN_SHUFFLE) + " must produce a power of two between 2 and " +
+                              std::to_string(MAX_VECTOR_LANES) + " lanes, got " + std::to_string(mask.size()));
+    }
+
+    auto* shuffle = state.builder->CreateShuffleVector(first->value, second, mask, "shuffle");
+    return std::make_unique<GeneratedValue>(first->type->getVectorElement()->getVectorType(mask.size()), shuffle);
+}
+
+static std::unique_ptr<GeneratedValue> codegenSelect(ModuleState& state,
+                                                     const DebugInfo& debugInfo,
+                                                     const std::vector<std::unique_ptr<ExprAST> >& args,
+                                                     GeneratedType* impliedType) {
+    if (!checkArgCount(state, debugInfo, BUILTIN_SELECT, args.size(), 3)) {
+        return nullptr;
+    }
+    auto condition = args[0]->codegenValue(state, nullptr);
+    if (!condition) {
+        return nullptr;
+    }
+    auto ifTrue = args[1]->codegenValue(state, impliedType);
+    if (!ifTrue) {
+        return nullptr;
+    }
+    auto ifFalse = args[2]->codegenValue(state, ifTrue->type);
+    if (!ifFalse) {
+        return nullptr;
+    }
+    if (ifTrue->type != ifFalse->type) {
+        return state.setError(debugInfo,
+                              builtinName(BUILTIN_SELECT) + " expects two values of the same type, got " +
+                              ifTrue->type->toString() + " and " + ifFalse->type->toString());
+    }
+    // A bool picks whole values, a bool vector picks lane by lane
+    auto* conditionType = GeneratedType::rawGet(KW_BOOL);
+    if (ifTrue->type->isVector() && condition->type->isVector()) {
+        conditionType = conditionType->getVectorType(ifTrue->type->getVectorLanes());
+    }
+    if (condition->type != conditionType) {
+        return state.setError(debugInfo,
+                              builtinName(BUILTIN_SELECT) + " between " + ifTrue->type->toString() +
+                              " values expects a " + conditionType->toString() + " condition, got " +
+                              condition->type->toString());
+    }
+    auto* select = state.builder->CreateSelect(condition->value, ifTrue->value, ifFalse->value, "select");
+    return std::make_unique<GeneratedValue>(ifTrue->type, select);
+}
+
+static std::unique_ptr<GeneratedValue> codegenReduce(ModuleState& state,
+                                                     const DebugInfo& debugInfo,
+                                                     const BuiltinKind builtin,
+                                                     const std::vector<std::unique_ptr<ExprAST> >& args) {
+    if (!checkArgCount(state, debugInfo, builtin, args.size(), 1)) {
+        return nullptr;
+    }
+    auto vector = args[0]->codegenValue(state, nullptr);
+    if (!vector) {
+        return nullptr;
+    }
+    if (!vector->type->isVector()) {
+        return state.setError(debugInfo, builtinName(builtin) + " expects a vector, got " + vector->type->toString());
+    }
+
+    auto* elementType = vector->type->getVectorElement();
+    auto isFloating = elementType->isFloating();
+    auto isSigned = elementType->isSigned();
+    auto isBitwise = builtin == BUILTIN_REDUCE_AND || builtin == BUILTIN_REDUCE_OR || builtin == BUILTIN_REDUCE_XOR;
+    if (isBitwise ? isFloating : !elementType->isNumber() && !isFloating) {
+        return state.setError(debugInfo,
+                              builtinName(builtin) + " is not defined for " + vector->type->toString());
+    }
+
+    auto* elementTy = elementType->getLLVMType(state);
+    Value* result;
+    switch (builtin) {
+        case BUILTIN_REDUCE_ADD:
+            result = isFloating
+                         ? state.builder->CreateFAddReduce(ConstantFP::getNegativeZero(elementTy), vector->value)
+                         : state.builder->CreateAddReduce(vector->value);
+            break;
+        case BUILTIN_REDUCE_MUL:
+            result = isFloating
+                         ? state.builder->CreateFMulReduce(ConstantFP::get(elementTy, 1.0), vector->value)
+                         : state.builder->CreateMulReduce(vector->value);
+            break;
+        case BUILTIN_REDUCE_MIN:
+            result = isFloating
+                         ? state.builder->CreateFPMinReduce(vector->value)
+                         : state.builder->CreateIntMinReduce(vector->value, isSigned);
+            break;
+        case BUILTIN_REDUCE_MAX:
+            result = isFloating
+                         ? state.builder->CreateFPMaxReduce(vector->value)
+                         : state.builder->CreateIntMaxReduce(vector->value, isSigned);
+            break;
+        case BUILTIN_REDUCE_AND:
+            result = state.builder->CreateAndReduce(vector->value);
+            break;
+        case BUILTIN_REDUCE_OR:
+            result = state.builder->CreateOrReduce(vector->value);
+            break;
+        case BUILTIN_REDUCE_XOR:
+            result = state.builder->CreateXorReduce(vector->value);
+            break;
+        default:
+            assert(false && "not a reduction");
+            return nullptr;
+    }
+    // Floating point sums and products are reduced in whatever order is fastest (i.e. pairwise), like hand written
+    // SIMD code would; a strictly ordered reduction is just a loop over the lanes
+    if (isFloating && (builtin == BUILTIN_REDUCE_ADD || builtin == BUILTIN_REDUCE_MUL)) {
+        cast<Instruction>(result)->setHasAllowReassoc(true);
+    }
+    return std::make_unique<GeneratedValue>(elementType, result);
+}
+
+std::unique_ptr<GeneratedValue> CallExprAST::codegenBuiltin(ModuleState& state, GeneratedType* impliedType) {
+    switch (builtin) {
+        case BUILTIN_POPCOUNT:
+        case BUILTIN_CTLZ:
+        case BUILTIN_CTTZ:
+        case BUILTIN_BSWAP:
+        case BUILTIN_ROTL:
+        case BUILTIN_ROTR:
+            return codegenBits(state, this->debugInfo, builtin, args, impliedType);
+        case BUILTIN_SQRT:
+        case BUILTIN_FMA:
+        case BUILTIN_MIN:
+        case BUILTIN_MAX:
+        case BUILTIN_ABS:
+            return codegenMath(state, this->debugInfo, builtin, args, impliedType);
+        case BUILTIN_MEMCPY:
+        case BUILTIN_MEMMOVE:
+        case BUILTIN_MEMSET:
+        case BUILTIN_PREFETCH:
+            return codegenMemory(state, this->debugInfo, builtin, args);
+        case BUILTIN_EXPECT:
+            return codegenExpect(state, this->debugInfo, args, impliedType);
+        case BUILTIN_SPLAT:
+            return codegenSplat(state, this->debugInfo, args, impliedType);
+        case BUILTIN_SHUFFLE:
+            return codegenShuffle(state, this->debugInfo, args);
+        case BUILTIN_SELECT:
+            return codegenSelect(state, this->debugInfo, args, impliedType);
+        case BUILTIN_REDUCE_ADD:
+        case BUILTIN_REDUCE_MUL:
+        case BUILTIN_REDUCE_MIN:
+        case BUILTIN_REDUCE_MAX:
+        case BUILTIN_REDUCE_AND:
+        case BUILTIN_REDUCE_OR:
+        case BUILTIN_REDUCE_XOR:
+            return codegenReduce(state, this->debugInfo, builtin, args);
+        case BUILTIN_NONE:
+            break;
+    }
+    assert(false && "unknown builtin");
+    return nullptr;
+}
@@ -1,7 +1,11 @@
 #include <ranges>
 
+#include <llvm/ADT/StringExtras.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Intrinsics.h>
+#include <llvm/Analysis/CFG.h>
+#include <llvm/IR/InstIterator.h>
 #include <llvm/IR/Verifier.h>
 
 #include "ast.h"
@@ -10,25 +14,199 @@
 #include "module/module_state.h"
 #include "module/generated.h"
 #include "lexer/lexer.h"
+#include "timing.h"
 
 using namespace llvm;
 
 // higher level
+std::unique_ptr<GeneratedValue> AssignableAST::load(ModuleState& state, std::unique_ptr<GeneratedValue> pointer) {
+    // TODO: this doesn't currently work unless you directly call the function
+    if (pointer->type->isFunction()) {
+        return pointer;
+    } else {
+        Value* val = state.builder->CreateLoad(pointer->type->getLLVMType(state), pointer->value, "pointer_load");
+        return std::make_unique<GeneratedValue>(pointer->type, val);
+    }
+}
+
 std::unique_ptr<GeneratedValue> AssignableAST::codegenValue(ModuleState& state, GeneratedType* impliedType) {
     auto maybePointer = codegenPointer(state);
     if (!maybePointer) {
         return nullptr;
     }
+    return load(state, std::move(maybePointer));
+}
 
-    // TODO: this doesn't currently work unless you directly call the function
-    if (maybePointer->type->isFunction()) {
-        return maybePointer;
-    } else {
-        Value* val = state.builder->CreateLoad(maybePointer->type->getLLVMType(state),
-                                               maybePointer->value,
-                                               "pointer_load");
-        return std::make_unique<GeneratedValue>(maybePointer->type, val);
+std::unique_ptr<GeneratedValue> AssignableAST::codegenAssignedValue(ModuleState& state,
+                                                                    const DebugInfo& debugInfo,
+                                                                    const OperatorKind op,
+                                                                    GeneratedType* targetType,
+                                                                    GeneratedValue* current,
+                                                                    ExprAST* valueExpr) {
+    auto value = valueExpr->codegenValue(state, targetType);
+    if (!value) {
+        return nullptr;
+    }
+    // Compound assignments combine with the current value directly instead of rewriting the AST, so the same AST can
+    // be codegenned again (i.e. by the daemon)
+    if (op != OP_ASSIGN) {
+        value = BinaryOpExprAST::codegenOp(state, debugInfo, COMPOUND_BINOPS[op], current, value.get());
+        if (!value) {
+            return nullptr;
+        }
+    }
+    if (targetType != value->type) {
+        return state.setError(debugInfo,
+                              "Wrong type assigned to variable: expected " + targetType->toString() + ", got " +
+                              value->type->toString());
+    }
+    return value;
+}
+
+bool AssignableAST::codegenStore(ModuleState& state,
+                                 const DebugInfo& debugInfo,
+                                 const OperatorKind op,
+                                 std::unique_ptr<GeneratedValue> pointer,
+                                 ExprAST* valueExpr) {
+    std::unique_ptr<GeneratedValue> current;
+    if (op != OP_ASSIGN) {
+        current = load(state, std::make_unique<GeneratedValue>(*pointer));
+    }
+    auto value = codegenAssignedValue(state, debugInfo, op, pointer->type, current.get(), valueExpr);
+    if (!value) {
+        return false;
+    }
+    state.builder->CreateStore(value->value, pointer->value);
+    return true;
+}
+
+bool AssignableAST::codegenAssign(ModuleState& state,
+                                  const DebugInfo& debugInfo,
+                                  const OperatorKind op,
+                                  ExprAST* valueExpr) {
+    auto pointer = codegenPointer(state);
+    if (!pointer) {
+        return false;
+    }
+    return codegenStore(state, debugInfo, op, std::move(pointer), valueExpr);
+}
+
+std::unique_ptr<GeneratedValue> MemberAccessExprAST::codegenValue(ModuleState& state, GeneratedType* impliedType) {
+    if (dynamic_cast<AssignableAST*>(structExpr.get())) {
+        return AssignableAST::codegenValue(state, impliedType);
+    }
+
+    // Inline structs that aren't stored anywhere (i.e. returned from a call) have no field to point to
+    auto structVal = structExpr->codegenValue(state, nullptr);
+    if (!structVal) {
+        return nullptr;
+    }
+    auto* genStruct = structVal->type->getGenStruct(state);
+    if (genStruct && genStruct->isInline && !genStruct->methods.contains(fieldName)) {
+        auto fieldIndex = genStruct->getFieldIndex(fieldName);
+        if (!fieldIndex.has_value()) {
+            return state.setError(this->debugInfo,
+                                  "Could not find field " + fieldName + " on type " + structVal->type->toString());
+        }
+        auto* field = state.builder->CreateExtractValue(structVal->value,
+                                                        std::vector<unsigned>{
+                                                            static_cast<unsigned>(fieldIndex.value())
+                                                        },
+                                                        genStruct->type->toString() + "_" + fieldName);
+        return std::make_unique<GeneratedValue>(std::get<1>(genStruct->fields[fieldIndex.value()]), field);
+    }
+    auto fieldPointer = codegenFieldPointer(state, std::move(structVal));
+    if (!fieldPointer) {
+        return nullptr;
+    }
+    return load(state, std::move(fieldPointer));
+}
+
+std::unique_ptr<GeneratedValue> SubscriptExprAST::codegenValue(ModuleState& state, GeneratedType* impliedType) {
+    // Lanes are read out of the whole vector value rather than through a pointer, since boolxN lanes are bit packed
+    auto arrayVal = arrayExpr->codegenValue(state, nullptr);
+    if (!arrayVal) {
+        return nullptr;
+    }
+    if (arrayVal->type->isVector()) {
+        auto indexVal = codegenIndex(state, arrayVal->type);
+        if (!indexVal) {
+            return nullptr;
+        }
+        auto* lane = state.builder->CreateExtractElement(arrayVal->value, indexVal->value, "lane");
+        return std::make_unique<GeneratedValue>(arrayVal->type->getVectorElement(), lane);
+    }
+    auto elementPointer = codegenElementPointer(state, std::move(arrayVal));
+    if (!elementPointer) {
+        return nullptr;
     }
+    return load(state, std::move(elementPointer));
+}
+
+std::unique_ptr<GeneratedValue> SliceExprAST::codegenBound(ModuleState& state,
+                                                           const std::unique_ptr<ExprAST>& boundExpr) {
+    auto boundVal = boundExpr->codegenValue(state, GeneratedType::rawGet(KW_USIZE));
+    if (!boundVal) {
+        return nullptr;
+    }
+    if (boundVal->type != GeneratedType::rawGet(KW_USIZE)) {
+        return state.setError(boundExpr->debugInfo,
+                              "Arrays must be sliced with usize type, got " + boundVal->type->toString());
+    }
+    return boundVal;
+}
+
+std::unique_ptr<GeneratedValue> SliceExprAST::codegenValue(ModuleState& state, GeneratedType* impliedType) {
+    auto arrayVal = arrayExpr->codegenValue(state, nullptr);
+    if (!arrayVal) {
+        return nullptr;
+    }
+    if (!arrayVal->type->isArray()) {
+        return state.setError(this->debugInfo, "Cannot slice type " + arrayVal->type->toString());
+    }
+
+    auto* length = state.builder->CreateExtractValue(arrayVal->value, std::vector<unsigned>{1}, "arr_len_extract");
+    auto startVal = startExpr
+                        ? codegenBound(state, startExpr)
+                        : std::make_unique<GeneratedValue>(GeneratedType::rawGet(KW_USIZE),
+                                                           ConstantInt::get(state.sizeTy, 0));
+    if (!startVal) {
+        return nullptr;
+    }
+    auto* start = startVal->value;
+    Value* end = length;
+    if (endExpr) {
+        auto endVal = codegenBound(state, endExpr);
+        if (!endVal) {
+            return nullptr;
+        }
+        end = endVal->value;
+    }
+
+    // The bounds are only checked here; the slice is an ordinary array afterwards, so indexing it costs nothing extra
+    auto* constantStart = dyn_cast<ConstantInt>(start);
+    auto* constantEnd = dyn_cast<ConstantInt>(end);
+    if (constantStart && constantEnd && constantStart->getValue().ugt(constantEnd->getValue())) {
+        return state.setError(this->debugInfo,
+                              "Slice start " + llvm::toString(constantStart->getValue(), 10, false) +
+                              " is past its end " + llvm::toString(constantEnd->getValue(), 10, false));
+    }
+    auto* inBounds = state.builder->CreateAnd(state.builder->CreateICmpULE(start, end, "slice_start_ok"),
+                                              state.builder->CreateICmpULE(end, length, "slice_end_ok"),
+                                              "slice_ok");
+    state.createBoundsCheck(inBounds, "slice");
+
+    // Same storage, narrower window; the slice never owns it, so nothing is allocated, copied or freed
+    auto startPointer = arrayVal->getArrayPointer(state, startVal);
+    auto* slice = state.builder->CreateInsertValue(PoisonValue::get(state.arrFatPtrTy),
+                                                   startPointer->value,
+                                                   std::vector<unsigned>{0},
+                                                   "slice_ptr_insert");
+    slice = state.builder->CreateInsertValue(slice,
+                                             state.builder->CreateSub(end, start, "slice_len"),
+                                             std::vector<unsigned>{1},
+                                             "slice_len_insert");
+    return std::make_unique<GeneratedValue>(arrayVal->type->getArrayBase()->getArrayType(false), slice);
 }
 
 // expr
@@ -40,168 +218,233 @@ bool ExprAST::codegen(ModuleState& state) {
     }
 }
 
+// Bit width of integer types, or 0 for everything else
+static unsigned intWidth(const ModuleState& state, GeneratedType* type) {
+    if (type == GeneratedType::rawGet(KW_LONG) || type == GeneratedType::rawGet(KW_ULONG)) {
+        return 64;
+    } else if (type == GeneratedType::rawGet(KW_INT) || type == GeneratedType::rawGet(KW_UINT)) {
+        return 32;
+    } else if (type == GeneratedType::rawGet(KW_BYTE) || type == GeneratedType::rawGet(KW_UBYTE)) {
+        return 8;
+    } else if (type == GeneratedType::rawGet(KW_ISIZE) || type == GeneratedType::rawGet(KW_USIZE)) {
+        return state.sizeTy->getIntegerBitWidth();
+    }
+    return 0;
+}
+
 std::unique_ptr<GeneratedValue> ValueExprAST::codegenValue(ModuleState& state, GeneratedType* impliedType) {
-    if (rawValue.front() == '\"' || rawValue.front() == '\'') {
-        auto rawStr = rawValue.substr(1, rawValue.length() - 2);
-        std::ostringstream ss;
-        int i = 0;
-        while (i < rawStr.length()) {
-            if (rawStr[i] == '\\' && i < rawStr.length() - 1) {
-                i += 1;
-                if (!ESCAPES.contains(rawStr[i])) {
-                    logWarning("Non escapeable character `" + std::string(1, rawStr[i]) + "` escaped");
-                    ss << rawStr[i];
-                } else {
-                    ss << ESCAPES.at(rawStr[i]);
-                }
-            } else {
-                ss << rawStr[i];
-            }
-            i += 1;
-        }
-        auto strVal = ss.str();
-
-        auto intern = state.getInternedString(strVal);
-        // TODO: make string type
-        auto baseType = GeneratedType::rawGet(KW_UBYTE);
-        return std::make_unique<GeneratedValue>(baseType->getArrayType(false), intern);
-    } else if (rawValue == KW_TRUE) {
-        return std::make_unique<GeneratedValue>(GeneratedType::rawGet(KW_BOOL), ConstantInt::getTrue(*state.ctx));
-    } else if (rawValue == KW_FALSE) {
-        return std::make_unique<GeneratedValue>(GeneratedType::rawGet(KW_BOOL), ConstantInt::getFalse(*state.ctx));
-    } else if (rawValue.find('.') != std::string::npos) {
-        APFloat apVal(APFloat::IEEEsingle());
-        if (impliedType == GeneratedType::rawGet(KW_DOUBLE)) {
-            apVal = APFloat(APFloat::IEEEdouble(), rawValue);
-        } else if (impliedType == GeneratedType::rawGet(KW_FLOAT)) {
-            apVal = APFloat(APFloat::IEEEsingle(), rawValue);
-        } else {
-            // Default floating type
-            impliedType = GeneratedType::rawGet(KW_DOUBLE);
-            apVal = APFloat(APFloat::IEEEdouble(), rawValue);
-        }
-        return std::make_unique<GeneratedValue>(impliedType, ConstantFP::get(impliedType->getLLVMType(state), apVal));
-    } else {
-        APInt apVal;
-        if (impliedType == GeneratedType::rawGet(KW_LONG) || impliedType == GeneratedType::rawGet(KW_ULONG)) {
-            apVal = APInt(64, rawValue, 10);
-        } else if (impliedType == GeneratedType::rawGet(KW_INT) || impliedType == GeneratedType::rawGet(KW_UINT)) {
-            apVal = APInt(32, rawValue, 10);
-        } else if (impliedType == GeneratedType::rawGet(KW_BYTE) || impliedType == GeneratedType::rawGet(KW_UBYTE)) {
-            apVal = APInt(8, rawValue, 10);
-        } else if (impliedType == GeneratedType::rawGet(KW_ISIZE) || impliedType == GeneratedType::rawGet(KW_USIZE)) {
-            apVal = APInt(state.sizeTy->getIntegerBitWidth(), rawValue, 10);
-        } else {
-            // Default int type
-            impliedType = GeneratedType::rawGet(KW_INT);
-            apVal = APInt(32, rawValue, 10);
-        }
-        // todo: if number overflows raise error
+    if (impliedType && impliedType->isVector() && literal.kind != LITERAL_STRING) {
+        // Scalar literals used as a vector are splatted to every lane
+        auto scalar = codegenValue(state, impliedType->getVectorElement());
+        if (!scalar || scalar->type != impliedType->getVectorElement()) {
+            return scalar;
+        }
         return std::make_unique<GeneratedValue>(impliedType,
-                                                ConstantInt::getIntegerValue(impliedType->getLLVMType(state), apVal));
+                                                ConstantVector::getSplat(
+                                                    ElementCount::getFixed(impliedType->getVectorLanes()),
+                                                    cast<Constant>(scalar->value)));
     }
+
+    switch (literal.kind) {
+        case LITERAL_STRING: {
+            auto intern = state.getInternedString(literal.string);
+            // TODO: make string type
+            auto baseType = GeneratedType::rawGet(KW_UBYTE);
+            return std::make_unique<GeneratedValue>(baseType->getArrayType(false), intern);
+        }
+        case LITERAL_BOOL:
+            return std::make_unique<GeneratedValue>(GeneratedType::rawGet(KW_BOOL),
+                                                    ConstantInt::getBool(*state.ctx, literal.integer));
+        case LITERAL_FLOAT: {
+            if (impliedType != GeneratedType::rawGet(KW_FLOAT) && impliedType != GeneratedType::rawGet(KW_DOUBLE)) {
+                // Default floating type
+                impliedType = GeneratedType::rawGet(KW_DOUBLE);
+            }
+            // Parsed straight from the source in the target precision; going through the double would round twice
+            auto& semantics = impliedType == GeneratedType::rawGet(KW_FLOAT) ? APFloat::IEEEsingle()
+                                                                             : APFloat::IEEEdouble();
+            APFloat value(semantics, StringRef(rawValue).ltrim('-'));
+            if (literal.negative) {
+                value.changeSign();
+            }
+            return std::make_unique<GeneratedValue>(impliedType,
+                                                    ConstantFP::get(impliedType->getLLVMType(state), value));
+        }
+        case LITERAL_INT: {
+            auto width = intWidth(state, impliedType);
+            if (width == 0) {
+                // Default int type
+                impliedType = GeneratedType::rawGet(KW_INT);
+                width = 32;
+            }
+            auto isSigned = impliedType->isSigned();
+            if (literal.negative && !isSigned && literal.integer != 0) {
+                return state.setError(this->debugInfo,
+                                      "Negative value " + rawValue + " for unsigned type " + impliedType->toString());
+            }
+            // Signed types go one further in the negative direction
+            auto max = APInt::getMaxValue(width).getZExtValue();
+            if (isSigned) {
+                max = APInt::getSignedMaxValue(width).getZExtValue() + (literal.negative ? 1 : 0);
+            }
+            if (literal.integer > max) {
+                return state.setError(this->debugInfo,
+                                      "Value " + rawValue + " doesn't fit in type " + impliedType->toString());
+            }
+            auto value = APInt(width, literal.integer);
+            if (literal.negative) {
+                value.negate();
+            }
+            return std::make_unique<GeneratedValue>(impliedType,
+                                                    ConstantInt::get(impliedType->getLLVMType(state), value));
+        }
+    }
+    assert(false);
+    return nullptr;
 }
 
-static std::unordered_map<std::string, Instruction::BinaryOps> ibinopMap{
-    {"+", Instruction::Add},
-    {"-", Instruction::Sub},
-    {"*", Instruction::Mul},
-    {"/", Instruction::SDiv},
-    {"%", Instruction::SRem},
-};
-static std::unordered_map<std::string, Instruction::BinaryOps> ubinopMap{
-    {"+", Instruction::Add},
-    {"-", Instruction::Sub},
-    {"*", Instruction::Mul},
-    {"/", Instruction::UDiv},
-    {"%", Instruction::URem},
-};
-static std::unordered_map<std::string, Instruction::BinaryOps> fbinopMap{
-    {"+", Instruction::FAdd},
-    {"-", Instruction::FSub},
-    {"*", Instruction::FMul},
-    {"/", Instruction::FDiv},
-    {"%", Instruction::FRem},
+// Operand kinds that select between signed, unsigned and floating point instructions
+enum OperandKind {
+    OPERAND_SIGNED,
+    OPERAND_UNSIGNED,
+    OPERAND_FLOATING,
+    OPERAND_KIND_COUNT,
 };
 
-static std::optional<Instruction::BinaryOps> getBinop(const std::string& binop,
+static OperandKind operandKind(const bool isSigned, const bool isFloating) {
+    return isFloating ? OPERAND_FLOATING : isSigned ? OPERAND_SIGNED : OPERAND_UNSIGNED;
+}
+
+// Instruction for every operator and operand kind; BinaryOpsEnd where there is none
+static constexpr auto BINOP_OPCODES = []() {
+    using Ops = std::array<Instruction::BinaryOps, OPERAND_KIND_COUNT>;
+    std::array<Ops, OPERATOR_COUNT> table{};
+    table.fill(Ops{Instruction::BinaryOpsEnd, Instruction::BinaryOpsEnd, Instruction::BinaryOpsEnd});
+    table[OP_ADD] = Ops{Instruction::Add, Instruction::Add, Instruction::FAdd};
+    table[OP_SUB] = Ops{Instruction::Sub, Instruction::Sub, Instruction::FSub};
+    table[OP_MUL] = Ops{Instruction::Mul, Instruction::Mul, Instruction::FMul};
+    table[OP_DIV] = Ops{Instruction::SDiv, Instruction::UDiv, Instruction::FDiv};
+    table[OP_REM] = Ops{Instruction::SRem, Instruction::URem, Instruction::FRem};
+    table[OP_SHL] = Ops{Instruction::Shl, Instruction::Shl, Instruction::BinaryOpsEnd};
+    table[OP_SHR] = Ops{Instruction::AShr, Instruction::LShr, Instruction::BinaryOpsEnd};
+    table[OP_BIT_AND] = Ops{Instruction::And, Instruction::And, Instruction::BinaryOpsEnd};
+    table[OP_BIT_XOR] = Ops{Instruction::Xor, Instruction::Xor, Instruction::BinaryOpsEnd};
+    table[OP_BIT_OR] = Ops{Instruction::Or, Instruction::Or, Instruction::BinaryOpsEnd};
+    return table;
+}();
+
+// Comparison predicate for every operator and operand kind; BAD_ICMP_PREDICATE for anything that isn't a comparison
+static constexpr auto CMP_PREDICATES = []() {
+    using Predicates = std::array<CmpInst::Predicate, OPERAND_KIND_COUNT>;
+    std::array<Predicates, OPERATOR_COUNT> table{};
+    table.fill(Predicates{CmpInst::BAD_ICMP_PREDICATE, CmpInst::BAD_ICMP_PREDICATE, CmpInst::BAD_ICMP_PREDICATE});
+    table[OP_EQ] = Predicates{CmpInst::ICMP_EQ, CmpInst::ICMP_EQ, CmpInst::FCMP_OEQ};
+    table[OP_NE] = Predicates{CmpInst::ICMP_NE, CmpInst::ICMP_NE, CmpInst::FCMP_ONE};
+    table[OP_LT] = Predicates{CmpInst::ICMP_SLT, CmpInst::ICMP_ULT, CmpInst::FCMP_OLT};
+    table[OP_GT] = Predicates{CmpInst::ICMP_SGT, CmpInst::ICMP_UGT, CmpInst::FCMP_OGT};
+    table[OP_LE] = Predicates{CmpInst::ICMP_SLE, CmpInst::ICMP_ULE, CmpInst::FCMP_OLE};
+    table[OP_GE] = Predicates{CmpInst::ICMP_SGE, CmpInst::ICMP_UGE, CmpInst::FCMP_OGE};
+    return table;
+}();
+
+static std::optional<Instruction::BinaryOps> getBinop(const OperatorKind binop,
                                                       const bool isSigned,
                                                       const bool isFloating) {
-    if (isFloating) {
-        if (fbinopMap.contains(binop)) {
-            return fbinopMap[binop];
-        }
-    } else if (isSigned) {
-        if (ibinopMap.contains(binop)) {
-            return ibinopMap[binop];
-        }
-    } else {
-        if (ubinopMap.contains(binop)) {
-            return ubinopMap[binop];
-        }
+    auto opcode = BINOP_OPCODES[binop][operandKind(isSigned, isFloating)];
+    if (opcode == Instruction::BinaryOpsEnd) {
+        return std::nullopt;
     }
-    return std::optional<Instruction::BinaryOps>();
+    return opcode;
 }
 
-static std::unordered_map<std::string, CmpInst::Predicate> icmpMap{
-    {"==", CmpInst::ICMP_EQ},
-    {"!=", CmpInst::ICMP_NE},
-    {"<", CmpInst::ICMP_SLT},
-    {">", CmpInst::ICMP_SGT},
-    {"<=", CmpInst::ICMP_SLE},
-    {">=", CmpInst::ICMP_SGE}
-};
-static std::unordered_map<std::string, CmpInst::Predicate> ucmpMap{
-    {"==", CmpInst::ICMP_EQ},
-    {"!=", CmpInst::ICMP_NE},
-    {"<", CmpInst::ICMP_ULT},
-    {">", CmpInst::ICMP_UGT},
-    {"<=", CmpInst::ICMP_ULE},
-    {">=", CmpInst::ICMP_UGE}
-};
-static std::unordered_map<std::string, CmpInst::Predicate> fcmpMap{
-    {"==", CmpInst::FCMP_OEQ},
-    {"!=", CmpInst::FCMP_ONE},
-    {"<", CmpInst::FCMP_OLT},
-    {">", CmpInst::FCMP_OGT},
-    {"<=", CmpInst::FCMP_OLE},
-    {">=", CmpInst::FCMP_OGE}
-};
+static bool isComparison(const OperatorKind op) {
+    return CMP_PREDICATES[op][OPERAND_SIGNED] != CmpInst::BAD_ICMP_PREDICATE;
+}
 
-static std::optional<CmpInst::Predicate> getCmpop(const std::string& cmpop,
+static std::optional<CmpInst::Predicate> getCmpop(const OperatorKind cmpop,
                                                   const bool isSigned,
                                                   const bool isFloating) {
-    if (isFloating) {
-        if (fcmpMap.contains(cmpop)) {
-            return fcmpMap[cmpop];
-        }
-    } else if (isSigned) {
-        if (icmpMap.contains(cmpop)) {
-            return icmpMap[cmpop];
-        }
-    } else {
-        if (ucmpMap.contains(cmpop)) {
-            return ucmpMap[cmpop];
-        }
+    auto predicate = CMP_PREDICATES[cmpop][operandKind(isSigned, isFloating)];
+    if (predicate == CmpInst::BAD_ICMP_PREDICATE) {
+        return std::nullopt;
     }
-    return std::optional<CmpInst::Predicate>();
+    return predicate;
+}
+
+// Evaluates an integer operation at compile time; nullopt if the result doesn't fit in the type, since then the
+// constant was almost certainly written wrong. Division by zero is checked by the caller.
+static std::optional<APInt> foldIntOp(const Instruction::BinaryOps op,
+                                      const APInt& L,
+                                      const APInt& R,
+                                      const bool isSigned) {
+    bool overflow = false;
+    APInt result;
+    switch (op) {
+        case Instruction::Add:
+            result = isSigned ? L.sadd_ov(R, overflow) : L.uadd_ov(R, overflow);
+            break;
+        case Instruction::Sub:
+            result = isSigned ? L.ssub_ov(R, overflow) : L.usub_ov(R, overflow);
+            break;
+        case Instruction::Mul:
+            result = isSigned ? L.smul_ov(R, overflow) : L.umul_ov(R, overflow);
+            break;
+        case Instruction::SDiv:
+            result = L.sdiv_ov(R, overflow);
+            break;
+        case Instruction::SRem:
+            result = L.srem(R);
+            break;
+        case Instruction::UDiv:
+            result = L.udiv(R);
+            break;
+        case Instruction::URem:
+            result = L.urem(R);
+            break;
+        // Shifting bits out is what shifts are for (i.e. 1 << 31); only shift amounts past the width are errors
+        case Instruction::Shl:
+        case Instruction::AShr:
+        case Instruction::LShr:
+            overflow = R.uge(L.getBitWidth());
+            if (!overflow) {
+                result = op == Instruction::Shl ? L.shl(R) : op == Instruction::AShr ? L.ashr(R) : L.lshr(R);
+            }
+            break;
+        case Instruction::And:
+            result = L & R;
+            break;
+        case Instruction::Xor:
+            result = L ^ R;
+            break;
+        case Instruction::Or:
+            result = L | R;
+            break;
+        default:
+            assert(false && "unknown integer binop");
+    }
+    if (overflow) {
+        return std::nullopt;
+    }
+    return result;
 }
 
 std::unique_ptr<GeneratedValue> BinaryOpExprAST::codegenValue(ModuleState& state, GeneratedType* impliedType) {
-    if (icmpMap.contains(binOp)) {
+    if (isComparison(binOp)) {
         impliedType = nullptr;
     }
 
     std::unique_ptr<GeneratedValue> L = LHS->codegenValue(state, impliedType);
     std::unique_ptr<GeneratedValue> R = RHS->codegenValue(state, impliedType);
+    // Only a constant's type depends on the implied type, and constants can be generated again without emitting
+    // anything, so those are the only operands worth retrying
     if (!impliedType && (!L || !R || L->type != R->type)) {
-        if (R) {
+        if (R && LHS->isConstant()) {
             auto tryL = LHS->codegenValue(state, R->type);
             if (tryL && tryL->type == R->type) {
                 L = std::move(tryL);
             }
         }
-        if (L && (!R || L->type != R->type)) {
+        if (L && (!R || L->type != R->type) && RHS->isConstant()) {
             auto tryR = RHS->codegenValue(state, L->type);
             if (tryR && tryR->type == L->type) {
                 R = std::move(tryR);
@@ -213,28 +456,62 @@ std::unique_ptr<GeneratedValue> BinaryOpExprAST::codegenValue(ModuleState& state
     }
     state.unsetError();
 
+    return codegenOp(state, this->debugInfo, binOp, L.get(), R.get());
+}
+
+std::unique_ptr<GeneratedValue> BinaryOpExprAST::codegenOp(ModuleState& state,
+                                                           const DebugInfo& debugInfo,
+                                                           const OperatorKind binOp,
+                                                           const GeneratedValue* L,
+                                                           const GeneratedValue* R) {
     if (L->type != R->type) {
-        return state.setError(this->debugInfo,
+        return state.setError(debugInfo,
                               "Binary expression between two values not the same type; got " + L->type->toString() +
                               " and " + R->type->
                               toString());
     }
-    bool isSigned = L->type->isSigned();
-    bool isFloating = L->type->isFloating();
+    // Vectors go through the same operators as their elements, applied lane by lane
+    bool isSigned = L->type->getScalarType()->isSigned();
+    bool isFloating = L->type->getScalarType()->isFloating();
 
     // TODO: clean all of this up (with cmpop check up there as well)
     std::optional<Instruction::BinaryOps> op = getBinop(binOp, isSigned, isFloating);
     std::optional<CmpInst::Predicate> cmpOp = getCmpop(binOp, isSigned, isFloating);
     GeneratedType* type;
     Value* val;
-    if (op.has_value()) {
+    auto* constantL = dyn_cast<ConstantInt>(L->value);
+    auto* constantR = dyn_cast<ConstantInt>(R->value);
+    if (op.has_value() && constantL && constantR) {
         type = L->type;
-        val = state.builder->CreateBinOp(op.value(), L->value, R->value, binOp + "_binop");
+        if (constantR->isZero() && (binOp == OP_DIV || binOp == OP_REM)) {
+            return state.setError(debugInfo, "Constant division by zero");
+        }
+        auto folded = foldIntOp(op.value(), constantL->getValue(), constantR->getValue(), isSigned);
+        if (!folded.has_value()) {
+            return state.setError(debugInfo,
+                                  "Constant expression " + llvm::toString(constantL->getValue(), 10, isSigned) + " " +
+                                  std::string(operatorString(binOp)) + " " +
+                                  llvm::toString(constantR->getValue(), 10, isSigned) + " overflows type " +
+                                  type->toString());
+        }
+        val = ConstantInt::get(*state.ctx, folded.value());
+    } else if (op.has_value()) {
+        type = L->type;
+        val = state.builder->CreateBinOp(op.value(),
+                                         L->value,
+                                         R->value,
+                                         std::string(operatorString(binOp)) + "_binop");
     } else if (cmpOp.has_value()) {
         type = GeneratedType::rawGet(KW_BOOL);
-        val = state.builder->CreateCmp(cmpOp.value(), L->value, R->value, binOp + "_cmpop");
+        if (L->type->isVector()) {
+            type = type->getVectorType(L->type->getVectorLanes());
+        }
+        val = state.builder->CreateCmp(cmpOp.value(),
+                                       L->value,
+                                       R->value,
+                                       std::string(operatorString(binOp)) + "_cmpop");
     } else {
-        return state.setError(this->debugInfo, "binop " + binOp + " not implemented yet");
+        return state.setError(debugInfo, "binop " + std::string(operatorString(binOp)) + " not implemented yet");
     }
     return std::make_unique<GeneratedValue>(type, val);
 }
@@ -246,15 +523,34 @@ std::unique_ptr<GeneratedValue> UnaryOpExprAST::codegenValue(ModuleState& state,
     }
 
     Value* val;
-    if (unaryOp == "-") {
-        val = state.builder->CreateNeg(genVal->value, unaryOp + "_unop");
+    if (unaryOp == OP_NEG && genVal->type->getScalarType()->isFloating()) {
+        val = state.builder->CreateFNeg(genVal->value, std::string(operatorString(unaryOp)) + "_unop");
+    } else if (unaryOp == OP_NEG) {
+        if (auto* constant = dyn_cast<ConstantInt>(genVal->value)) {
+            bool isSigned = genVal->type->isSigned();
+            if (isSigned ? constant->getValue().isMinSignedValue() : !constant->isZero()) {
+                return state.setError(this->debugInfo,
+                                      "Constant expression -" + llvm::toString(constant->getValue(), 10, isSigned) +
+                                      " overflows type " + genVal->type->toString());
+            }
+        }
+        val = state.builder->CreateNeg(genVal->value, std::string(operatorString(unaryOp)) + "_unop");
+    } else if ((unaryOp == OP_NOT && genVal->type->getScalarType()->isBool()) ||
+               (unaryOp == OP_BIT_NOT && genVal->type->getScalarType()->isNumber())) {
+        val = state.builder->CreateNot(genVal->value, std::string(operatorString(unaryOp)) + "_unop");
     } else {
-        return state.setError(this->debugInfo, "unop " + unaryOp + " not implemented yet");
+        return state.setError(this->debugInfo,
+                              "unop " + std::string(operatorString(unaryOp)) + " is not defined for type " +
+                              genVal->type->toString());
     }
     return std::make_unique<GeneratedValue>(genVal->type, val);
 }
 
 std::unique_ptr<GeneratedValue> CallExprAST::codegenValue(ModuleState& state, GeneratedType* impliedType) {
+    if (builtin != BUILTIN_NONE) {
+        return codegenBuiltin(state, impliedType);
+    }
+
     auto calleeValue = callee->codegenValue(state, nullptr);
     if (!calleeValue) {
         return nullptr;
@@ -291,6 +587,9 @@ std::unique_ptr<GeneratedValue> CallExprAST::codegenValue(ModuleState& state, Ge
                                           calleeValue->value,
                                           argsV,
                                           twine);
+    if (auto* function = dyn_cast<Function>(calleeValue->value)) {
+        val->setCallingConv(function->getCallingConv());
+    }
     return std::make_unique<GeneratedValue>(calleeValue->type->getReturnType(), val);
 }
 
@@ -301,11 +600,19 @@ std::unique_ptr<GeneratedValue> ConstructorExprAST::codegenValue(ModuleState& st
                               "Attempted to call constructor for undefined or non-struct type " + type->toString());
     }
 
-    auto* structPointer = createMalloc(state,
-                                       state.builder->CreateTrunc(ConstantExpr::getSizeOf(genStruct->structType),
-                                                                  state.sizeTy),
-                                       type->toString());
-    auto structVal = std::make_unique<GeneratedValue>(genStruct->type, structPointer);
+    std::unique_ptr<GeneratedValue> structVal;
+    if (genStruct->isInline) {
+        // Built up as a plain value; it only ends up in memory once it's stored in a variable, field or array
+        structVal = std::make_unique<GeneratedValue>(genStruct->type, PoisonValue::get(genStruct->structType));
+    } else {
+        auto* structPointer = createMalloc(state,
+                                           state.builder->CreateTrunc(ConstantExpr::getSizeOf(genStruct->structType),
+                                                                      state.sizeTy),
+                                           type->toString(),
+                                           genStruct->type,
+                                           this->debugInfo);
+        structVal = std::make_unique<GeneratedValue>(genStruct->type, structPointer);
+    }
 
     auto used = std::unordered_set<std::string>();
     for (auto& [fieldName, fieldExpr]: values) {
@@ -316,10 +623,25 @@ std::unique_ptr<GeneratedValue> ConstructorExprAST::codegenValue(ModuleState& st
                                   "struct " + genStruct->type->toString() + " has no field " + fieldName);
         }
 
-        auto fieldValue = fieldExpr->codegenValue(state, std::get<1>(genStruct->fields[fieldIndex.value()]));
+        auto fieldType = std::get<1>(genStruct->fields[fieldIndex.value()]);
+        auto fieldValue = fieldExpr->codegenValue(state, fieldType);
         if (!fieldValue) {
             return nullptr;
         }
+        if (genStruct->isInline) {
+            if (fieldType != fieldValue->type) {
+                return state.setError(this->debugInfo,
+                                      "Invalid type for field " + fieldName + "; expected " + fieldType->toString() +
+                                      ", got " + fieldValue->type->toString());
+            }
+            structVal->value = state.builder->CreateInsertValue(structVal->value,
+                                                                fieldValue->value,
+                                                                std::vector<unsigned>{
+                                                                    static_cast<unsigned>(fieldIndex.value())
+                                                                },
+                                                                type->toString() + "_" + fieldName);
+            continue;
+        }
         auto fieldPointer = structVal->getFieldPointer(state, fieldName);
         if (!fieldPointer) {
             return state.setError(this->debugInfo,
@@ -343,6 +665,31 @@ std::unique_ptr<GeneratedValue> ConstructorExprAST::codegenValue(ModuleState& st
 }
 
 std::unique_ptr<GeneratedValue> ArrayExprAST::codegenValue(ModuleState& state, GeneratedType* impliedType) {
+    if (impliedType && impliedType->isVector()) {
+        // Array literals of a vector type build the vector directly, one element per lane
+        auto* elementType = impliedType->getVectorElement();
+        if (values.size() != impliedType->getVectorLanes()) {
+            return state.setError(this->debugInfo,
+                                  "Vector type " + impliedType->toString() + " has " +
+                                  std::to_string(impliedType->getVectorLanes()) + " lanes, got " +
+                                  std::to_string(values.size()) + " values");
+        }
+        Value* vector = PoisonValue::get(impliedType->getLLVMType(state));
+        for (size_t i = 0; i < values.size(); i++) {
+            auto lane = values[i]->codegenValue(state, elementType);
+            if (!lane) {
+                return nullptr;
+            }
+            if (lane->type != elementType) {
+                return state.setError(this->debugInfo,
+                                      "Mismatched types in vector: expected " + elementType->toString() + ", got " +
+                                      lane->type->toString());
+            }
+            vector = state.builder->CreateInsertElement(vector, lane->value, i, "lane_insert");
+        }
+        return std::make_unique<GeneratedValue>(impliedType, vector);
+    }
+
     std::vector<std::unique_ptr<GeneratedValue> > genValues;
     GeneratedType* baseType = impliedType ? impliedType->getArrayBase() : nullptr;
     for (const auto& expr: values) {
@@ -363,15 +710,55 @@ std::unique_ptr<GeneratedValue> ArrayExprAST::codegenValue(ModuleState& state, G
         return state.setError(this->debugInfo, "Unable to infer type of array");
     }
 
-    auto* typeSize = state.builder->
-            CreateTrunc(ConstantExpr::getSizeOf(baseType->getLLVMType(state)), state.sizeTy);
+    auto* elementTy = baseType->getLLVMType(state);
+    auto* typeSize = state.builder->CreateTrunc(ConstantExpr::getSizeOf(elementTy), state.sizeTy);
     auto* allocSize = state.builder->CreateMul(ConstantInt::get(state.sizeTy, genValues.size()), typeSize);
 
+    // Literals made only of constants (i.e. lookup tables) are emitted once as a global, instead of one store per
+    // element every time the literal is evaluated
+    GlobalVariable* constantLiteral = nullptr;
+    auto allConstant = std::ranges::all_of(genValues, [](const auto& genValue) {
+        return isa<Constant>(genValue->value);
+    });
+    if (allConstant && !genValues.empty()) {
+        std::vector<Constant*> elements;
+        for (const auto& genValue: genValues) {
+            elements.push_back(cast<Constant>(genValue->value));
+        }
+        // Borrowed uses point straight at the global, so it lives as long as the program and every evaluation of
+        // the literal borrows the same elements. Borrowed arrays are writable, so that global can't be constant.
+        auto borrowed = impliedType && impliedType->isArray() && !impliedType->isOwned();
+        auto* literalTy = ArrayType::get(elementTy, elements.size());
+        constantLiteral = new GlobalVariable(*state.module,
+                                             literalTy,
+                                             !borrowed,
+                                             GlobalValue::PrivateLinkage,
+                                             ConstantArray::get(literalTy, elements),
+                                             "array_literal");
+        if (!borrowed) {
+            constantLiteral->setUnnamedAddr(GlobalValue::UnnamedAddr::Global);
+        }
+        constantLiteral->setAlignment(state.dl->getABITypeAlign(elementTy));
+
+        if (borrowed) {
+            return std::make_unique<GeneratedValue>(baseType->getArrayType(false),
+                                                    createArrayFatPointer(state, constantLiteral, values.size()));
+        }
+    }
+
     // TODO: figure out if we need to align anything ever? I don't think we do as long as we ensure structs are aligned
-    auto* arrayPointer = createMalloc(state, allocSize, "array");
+    auto* arrayPointer = createMalloc(state, allocSize, "array", baseType->getArrayType(true), this->debugInfo);
     auto* arrayFatPointer = createArrayFatPointer(state, arrayPointer, values.size());
     auto arrayValue = std::make_unique<GeneratedValue>(baseType->getArrayType(true), arrayFatPointer);
 
+    if (constantLiteral) {
+        state.builder->CreateMemCpy(arrayPointer,
+                                    constantLiteral->getAlign(),
+                                    constantLiteral,
+                                    constantLiteral->getAlign(),
+                                    allocSize);
+        return arrayValue;
+    }
     for (auto&& [i, genValue]: enumerate(genValues)) {
         auto indexValue = std::make_unique<GeneratedValue>(GeneratedType::rawGet(KW_USIZE),
                                                            state.builder->CreateTrunc(
@@ -395,10 +782,6 @@ bool ImportAST::codegen(ModuleState& state) {
 
 bool StructAST::codegen(ModuleState& state) {
     for (const auto& method: methods | std::views::values) {
-        if (method->isExtern) {
-            state.setError(this->debugInfo, "Structs cannot have extern methods");
-            return false;
-        }
         if (!method->codegen(state)) {
             return false;
         }
@@ -407,6 +790,7 @@ bool StructAST::codegen(ModuleState& state) {
 }
 
 bool FuncAST::codegen(ModuleState& state) {
+    PhaseTimer timer("codegen function", funcName);
     if (!declaration) {
         state.setError(this->debugInfo, "Function not declared (this should not happen!)");
         return false;
@@ -440,8 +824,11 @@ bool FuncAST::codegen(ModuleState& state) {
     state.builder->SetInsertPoint(BB);
 
     state.enterFunc(declaration.get());
-    for (const auto& [type, identifier]: signature) {
-        if (!state.registerVar(identifier, type)) {
+    state.beginDebugFunction(function, funcName, this->debugInfo);
+    state.instrumentEntry(function);
+    for (int i = 0; i < signature.size(); i++) {
+        const auto& [type, identifier] = signature[i];
+        if (!state.registerVar(identifier, type, i + 1)) {
             state.setError(this->debugInfo,
                            "Duplicate identifier " + identifier + " in signature of function " + funcName);
             return false;
@@ -449,7 +836,7 @@ bool FuncAST::codegen(ModuleState& state) {
     }
 
     for (int i = 0; i < signature.size(); i++) {
-        auto* genVar = state.getVar(signature[i].identifier);
+        auto genVar = state.getVar(signature[i].identifier);
         if (!genVar->type->isDefined(state)) {
             state.setError(this->debugInfo, "Unknown type " + genVar->type->toString());
             return false;
@@ -460,74 +847,95 @@ bool FuncAST::codegen(ModuleState& state) {
     if (!block->get()->codegen(state)) {
         return false;
     }
+    // Void functions may fall off the end of their block
+    if (returnType->isVoid() && !state.builder->GetInsertBlock()->getTerminator()) {
+        state.instrumentExit();
+        state.builder->CreateRetVoid();
+    }
 
     for (auto const& [type, identifier]: signature) {
         state.identifiers.erase(identifier);
     }
     state.exitFunc();
+    state.endDebugFunction();
 
     std::string result;
     raw_string_ostream stream(result);
+    PhaseTimer verifyTimer("verify function", funcName);
     if (verifyFunction(*function, &stream)) {
         state.setError(this->debugInfo, "Error verifying function (this should not happen!): " + result);
         return false;
     }
+    addInferredAttributes(state, function);
     return true;
 }
 
+void FuncAST::addInferredAttributes(ModuleState& state, Function* function) {
+    // Struct values are always pointers to a whole, allocated struct (inline structs are passed by value)
+    for (int i = 0; i < signature.size(); i++) {
+        auto* genStruct = signature[i].type->getGenStruct(state);
+        if (!genStruct || genStruct->isInline) {
+            continue;
+        }
+        function->addParamAttr(i, Attribute::NonNull);
+        function->addDereferenceableParamAttr(i, state.dl->getTypeAllocSize(genStruct->structType));
+    }
+
+    // Provable when there are no loops and every call is to a function that's already known to return
+    SmallVector<std::pair<const BasicBlock*, const BasicBlock*> > backedges;
+    FindFunctionBackedges(*function, backedges);
+    if (!backedges.empty()) {
+        return;
+    }
+    for (const auto& instruction: instructions(*function)) {
+        if (auto* call = dyn_cast<CallBase>(&instruction)) {
+            auto* callee = call->getCalledFunction();
+            if (!callee || !callee->willReturn()) {
+                return;
+            }
+        }
+    }
+    function->addFnAttr(Attribute::WillReturn);
+}
+
 // statements
 bool VarAST::codegen(ModuleState& state) {
     if (type.has_value() && !definition) {
         state.setError(this->debugInfo, "Can only set variable type on definition");
         return false;
     }
-    if (definition && varOp != "=") {
+    if (definition && varOp != OP_ASSIGN) {
         state.setError(this->debugInfo, "Cannot use binary variable assignment operator on variable definition");
     }
 
-    std::unique_ptr<GeneratedValue> varPointer;
-    std::unique_ptr<GeneratedValue> value;
+    if (!definition) {
+        return variableExpr->codegenAssign(state, this->debugInfo, varOp, expr.get());
+    }
 
-    // fml ;)
-    if (definition) {
-        value = expr->codegenValue(state, type.value_or(nullptr));
-        if (!value) {
-            return false;
-        }
+    auto value = expr->codegenValue(state, type.value_or(nullptr));
+    if (!value) {
+        return false;
+    }
 
-        auto raw = dynamic_cast<VariableExprAST*>(variableExpr.get());
-        if (!raw) {
-            state.setError(this->debugInfo, "Cannot define variables with accessors");
-            return false;
-        }
-        GeneratedType* varType = type.value_or(value->type);
-        if (!varType->isDefined(state)) {
-            state.setError(this->debugInfo, "Unknown type " + varType->toString());
-            return false;
-        }
+    auto raw = dynamic_cast<VariableExprAST*>(variableExpr.get());
+    if (!raw) {
+        state.setError(this->debugInfo, "Cannot define variables with accessors");
+        return false;
+    }
+    GeneratedType* varType = type.value_or(value->type);
+    if (!varType->isDefined(state)) {
+        state.setError(this->debugInfo, "Unknown type " + varType->toString());
+        return false;
+    }
 
-        if (!state.registerVar(raw->varName, varType)) {
-            state.setError(this->debugInfo, "Duplicate identifier " + raw->varName);
-            return false;
-        }
+    if (!state.registerVar(raw->varName, varType)) {
+        state.setError(this->debugInfo, "Duplicate identifier " + raw->varName);
+        return false;
+    }
 
-        varPointer = variableExpr->codegenPointer(state);
-        if (!varPointer) {
-            return false;
-        }
-    } else {
-        varPointer = variableExpr->codegenPointer(state);
-        if (!varPointer) {
-            return false;
-        }
-        if (varOp != "=") {
-            auto binOp = varOp.substr(0, varOp.size() - 1);
-            expr = std::make_unique<BinaryOpExprAST>(std::move(variableExpr), std::move(expr), binOp);
-        }
-        value = expr->codegenValue(state, varPointer->type);
-        if (!value) {
-            return false;
-        }
+    auto varPointer = variableExpr->codegenPointer(state);
+    if (!varPointer) {
+        return false;
     }
 
     if (varPointer->type != value->type) {
@@ -545,7 +953,7 @@ bool IfAST::codegen(ModuleState& state) {
     if (!val) {
         return false;
     }
-    if (val->type->isBool()) {
+    if (!val->type->isBool()) {
         state.setError(this->debugInfo, "Must use bool type in if statement");
         return false;
     }
@@ -566,7 +974,10 @@ bool IfAST::codegen(ModuleState& state) {
     if (!block->codegen(state)) {
         return false;
     }
-    state.builder->CreateBr(mergeBB);
+    // Blocks ending in a return already have a terminator
+    if (!state.builder->GetInsertBlock()->getTerminator()) {
+        state.builder->CreateBr(mergeBB);
+    }
 
     if (elseBlock.has_value()) {
         func->insert(func->end(), elseBB);
@@ -574,7 +985,9 @@ bool IfAST::codegen(ModuleState& state) {
         if (!elseBlock.value()->codegen(state)) {
             return false;
         }
-        state.builder->CreateBr(mergeBB);
+        if (!state.builder->GetInsertBlock()->getTerminator()) {
+            state.builder->CreateBr(mergeBB);
+        }
     }
 
     func->insert(func->end(), mergeBB);
@@ -608,7 +1021,9 @@ bool WhileAST::codegen(ModuleState& state) {
     if (!block->codegen(state)) {
         return false;
     }
-    state.builder->CreateBr(condBB);
+    if (!state.builder->GetInsertBlock()->getTerminator()) {
+        state.builder->CreateBr(condBB);
+    }
 
     func->insert(func->end(), postBB);
     state.builder->SetInsertPoint(postBB);
@@ -632,12 +1047,14 @@ bool ReturnAST::codegen(ModuleState& state) {
                            toString());
             return false;
         }
+        state.instrumentExit();
         state.builder->CreateRet(returnValue->value);
     } else {
         if (!returnType->isVoid()) {
             state.setError(this->debugInfo, "Expected return type of " + returnType->toString() + ", got void");
             return false;
         }
+        state.instrumentExit();
         state.builder->CreateRetVoid();
     }
     return true;
@@ -646,7 +1063,9 @@ bool ReturnAST::codegen(ModuleState& state) {
 // other
 bool BlockAST::codegen(ModuleState& state) {
     state.enterScope();
+    state.coverRegion(this->debugInfo);
     for (const auto& statement: statements) {
+        state.setDebugLocation(statement->debugInfo);
         if (!statement->codegen(state)) {
             return false;
         }
@@ -655,7 +1074,29 @@ bool BlockAST::codegen(ModuleState& state) {
     return true;
 }
 
+bool UnitAST::codegenQueued(ModuleState& state) {
+    PhaseTimer timer("codegen unit", unit);
+    state.enterCodegenUnit(unit);
+    state.enterTypeUnit(unit);
+    state.enterScope();
+    for (const auto& statement: statements) {
+        if (!statement->postregister(state, unit)) {
+            return false;
+        }
+    }
+    while (auto* body = state.nextQueuedBody(unit)) {
+        if (!body->codegen(state)) {
+            return false;
+        }
+    }
+    state.exitScope();
+    return true;
+}
+
 bool UnitAST::codegen(ModuleState& state) {
+    PhaseTimer timer("codegen unit", unit);
+    state.enterCodegenUnit(unit);
+    state.enterTypeUnit(unit);
     state.enterScope();
     for (const auto& statement: statements) {
         if (!statement->postregister(state, unit)) {
@@ -664,10 +1105,20 @@ bool UnitAST::codegen(ModuleState& state) {
     }
 
     for (const auto& statement: statements) {
+        // Function and method bodies come from the reachability queue instead
+        if (state.deferringBodies() &&
+            (dynamic_cast<FuncAST*>(statement.get()) || dynamic_cast<StructAST*>(statement.get()))) {
+            continue;
+        }
         if (!statement->codegen(state)) {
             return false;
         }
     }
+    while (auto* body = state.nextQueuedBody(unit)) {
+        if (!body->codegen(state)) {
+            return false;
+        }
+    }
     state.exitScope();
     return true;
 }
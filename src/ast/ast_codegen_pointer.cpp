@@ -4,18 +4,15 @@
 #include "module/module_state.h"
 
 std::unique_ptr<GeneratedValue> VariableExprAST::codegenPointer(ModuleState& state) {
-    auto* genVar = state.getVar(varName);
+    auto genVar = state.getVar(varName);
     if (!genVar) {
         return state.setError(this->debugInfo, "Undefined variable " + varName);
     }
-    return std::make_unique<GeneratedValue>(genVar->type, genVar->value);
+    return genVar;
 }
 
-std::unique_ptr<GeneratedValue> MemberAccessExprAST::codegenPointer(ModuleState& state) {
-    auto structVal = structExpr->codegenValue(state, nullptr);
-    if (!structVal) {
-        return nullptr;
-    }
+std::unique_ptr<GeneratedValue> MemberAccessExprAST::codegenFieldPointer(ModuleState& state,
+                                                                         std::unique_ptr<GeneratedValue> structVal) {
     auto fieldPointer = structVal->getFieldPointer(state, fieldName);
     if (!fieldPointer) {
         return state.setError(this->debugInfo,
@@ -24,18 +21,65 @@ std::unique_ptr<GeneratedValue> MemberAccessExprAST::codegenPointer(ModuleState&
     return fieldPointer;
 }
 
-std::unique_ptr<GeneratedValue> SubscriptExprAST::codegenPointer(ModuleState& state) {
-    auto arrayVal = arrayExpr->codegenValue(state, nullptr);
-    if (!arrayVal) {
+std::unique_ptr<GeneratedValue> MemberAccessExprAST::codegenPointer(ModuleState& state) {
+    auto* assignable = dynamic_cast<AssignableAST*>(structExpr.get());
+    if (!assignable) {
+        auto structVal = structExpr->codegenValue(state, nullptr);
+        if (!structVal) {
+            return nullptr;
+        }
+        auto* genStruct = structVal->type->getGenStruct(state);
+        if (genStruct && genStruct->isInline && !genStruct->methods.contains(fieldName)) {
+            return state.setError(this->debugInfo, "Cannot assign to a field of a temporary inline struct");
+        }
+        return codegenFieldPointer(state, std::move(structVal));
+    }
+
+    auto storage = assignable->codegenPointer(state);
+    if (!storage) {
         return nullptr;
     }
+    // Inline structs live in the storage itself, so the field is addressed inside it without loading anything
+    auto* genStruct = storage->type->getGenStruct(state);
+    if (genStruct && genStruct->isInline) {
+        return codegenFieldPointer(state, std::move(storage));
+    }
+    return codegenFieldPointer(state, load(state, std::move(storage)));
+}
+
+std::unique_ptr<GeneratedValue> SubscriptExprAST::codegenIndex(ModuleState& state, GeneratedType* indexedType) {
     auto indexVal = indexExpr->codegenValue(state, GeneratedType::rawGet(KW_USIZE));
     if (!indexVal) {
         return nullptr;
     }
     if (indexVal->type != GeneratedType::rawGet(KW_USIZE)) {
         return state.setError(this->debugInfo,
-                              "Arrays must be indexed with usize type, got " + indexVal->type->toString());
+                              std::string(indexedType->isVector() ? "Vectors" : "Arrays") +
+                              " must be indexed with usize type, got " + indexVal->type->toString());
+    }
+    // Vectors have a fixed number of lanes, so constant lanes can be checked right away
+    auto* constantIndex = dyn_cast<ConstantInt>(indexVal->value);
+    if (indexedType->isVector() && constantIndex && constantIndex->getValue().uge(indexedType->getVectorLanes())) {
+        return state.setError(this->debugInfo,
+                              "Lane " + std::to_string(constantIndex->getZExtValue()) + " out of range for type " +
+                              indexedType->toString());
+    }
+    if (indexedType->isVector() && !constantIndex) {
+        // Out of range lanes would read poison or store nowhere, so they trap like out of bounds slices
+        state.createBoundsCheck(state.builder->CreateICmpULT(indexVal->value,
+                                                             ConstantInt::get(state.sizeTy,
+                                                                              indexedType->getVectorLanes()),
+                                                             "lane_in_range"),
+                                "lane");
+    }
+    return indexVal;
+}
+
+std::unique_ptr<GeneratedValue> SubscriptExprAST::codegenElementPointer(ModuleState& state,
+                                                                        std::unique_ptr<GeneratedValue> arrayVal) {
+    auto indexVal = codegenIndex(state, arrayVal->type);
+    if (!indexVal) {
+        return nullptr;
     }
     auto indexPointer = arrayVal->getArrayPointer(state, indexVal);
     if (!indexPointer) {
@@ -43,3 +87,70 @@ std::unique_ptr<GeneratedValue> SubscriptExprAST::codegenPointer(ModuleState& st
     }
     return indexPointer;
 }
+
+std::unique_ptr<GeneratedValue> SubscriptExprAST::codegenPointer(ModuleState& state) {
+    auto* assignable = dynamic_cast<AssignableAST*>(arrayExpr.get());
+    if (!assignable) {
+        auto arrayVal = arrayExpr->codegenValue(state, nullptr);
+        if (!arrayVal) {
+            return nullptr;
+        }
+        if (arrayVal->type->isVector()) {
+            return state.setError(this->debugInfo, "Cannot assign to a lane of a temporary vector");
+        }
+        return codegenElementPointer(state, std::move(arrayVal));
+    }
+
+    auto storage = assignable->codegenPointer(state);
+    if (!storage) {
+        return nullptr;
+    }
+    if (storage->type->isVector()) {
+        return state.setError(this->debugInfo, "Vector lanes can only be read or assigned, not addressed");
+    }
+    return codegenElementPointer(state, load(state, std::move(storage)));
+}
+
+bool SubscriptExprAST::codegenAssign(ModuleState& state,
+                                     const DebugInfo& debugInfo,
+                                     const OperatorKind op,
+                                     ExprAST* valueExpr) {
+    auto* assignable = dynamic_cast<AssignableAST*>(arrayExpr.get());
+    if (!assignable) {
+        return AssignableAST::codegenAssign(state, debugInfo, op, valueExpr);
+    }
+    auto storage = assignable->codegenPointer(state);
+    if (!storage) {
+        return false;
+    }
+    if (!storage->type->isVector()) {
+        auto elementPointer = codegenElementPointer(state, load(state, std::move(storage)));
+        if (!elementPointer) {
+            return false;
+        }
+        return codegenStore(state, debugInfo, op, std::move(elementPointer), valueExpr);
+    }
+
+    // boolxN lanes are bit packed and can't be pointed to, so the lane is inserted into the whole vector instead
+    auto indexVal = codegenIndex(state, storage->type);
+    if (!indexVal) {
+        return false;
+    }
+    auto* vectorTy = storage->type->getLLVMType(state);
+    auto* laneType = storage->type->getVectorElement();
+    std::unique_ptr<GeneratedValue> current;
+    if (op != OP_ASSIGN) {
+        auto* vector = state.builder->CreateLoad(vectorTy, storage->value, "vector_load");
+        auto* lane = state.builder->CreateExtractElement(vector, indexVal->value, "lane");
+        current = std::make_unique<GeneratedValue>(laneType, lane);
+    }
+    auto value = codegenAssignedValue(state, debugInfo, op, laneType, current.get(), valueExpr);
+    if (!value) {
+        return false;
+    }
+    // Loaded only now, since the assigned value may have been computed by a call that changes the vector
+    auto* vector = state.builder->CreateLoad(vectorTy, storage->value, "vector_load");
+    state.builder->CreateStore(state.builder->CreateInsertElement(vector, value->value, indexVal->value, "lane_insert"),
+                               storage->value);
+    return true;
+}
@@ -1,9 +1,11 @@
+#include <charconv>
 #include <iostream>
 #include <memory>
 
 #include "lexer/lexer.h"
 #include "ast.h"
 #include "module/generated.h"
+#include "logging.h"
 
 GeneratedType* parseType(Lexer& lexer) {
     if (lexer.curToken.type != TOK_TYPE && lexer.curToken.type != TOK_IDENTIFIER) {
@@ -28,13 +30,74 @@ GeneratedType* parseType(Lexer& lexer) {
     return GeneratedType::rawGet(type);
 }
 
+// ~ starts arrays (~[...]) and constructors (~Type {...}), and is the bitwise not operator everywhere else
+static bool startsConstructor(Lexer& lexer) {
+    auto next = lexer.peek(1);
+    if (next.rawToken == "[") {
+        return true;
+    }
+    // peek skips whitespace from where it lands, so the { can be either one or two further depending on spacing
+    return (next.type == TOK_TYPE || next.type == TOK_IDENTIFIER) &&
+           (lexer.peek(2).rawToken == "{" || lexer.peek(3).rawToken == "{");
+}
+
+static std::optional<Literal> parseLiteral(Lexer& lexer) {
+    const auto& raw = lexer.curToken.rawToken;
+    Literal literal;
+    if (raw.front() == '\"' || raw.front() == '\'') {
+        literal.kind = LITERAL_STRING;
+        auto rawStr = raw.substr(1, raw.length() - 2);
+        int i = 0;
+        while (i < rawStr.length()) {
+            if (rawStr[i] == '\\' && i < rawStr.length() - 1) {
+                i += 1;
+                if (!ESCAPES.contains(rawStr[i])) {
+                    logWarning("Non escapeable character `" + std::string(1, rawStr[i]) + "` escaped");
+                    literal.string += rawStr[i];
+                } else {
+                    literal.string += ESCAPES.at(rawStr[i]);
+                }
+            } else {
+                literal.string += rawStr[i];
+            }
+            i += 1;
+        }
+    } else if (raw == KW_TRUE || raw == KW_FALSE) {
+        literal.kind = LITERAL_BOOL;
+        literal.integer = raw == KW_TRUE;
+    } else if (raw.find('.') != std::string::npos) {
+        literal.kind = LITERAL_FLOAT;
+        auto [end, ec] = std::from_chars(raw.data(), raw.data() + raw.size(), literal.floating);
+        if (ec != std::errc() || end != raw.data() + raw.size()) {
+            lexer.parsingError = "Invalid number " + raw;
+            return std::nullopt;
+        }
+    } else {
+        literal.kind = LITERAL_INT;
+        auto [end, ec] = std::from_chars(raw.data(), raw.data() + raw.size(), literal.integer);
+        if (ec == std::errc::result_out_of_range) {
+            lexer.parsingError = "Integer " + raw + " is too large for any integer type";
+            return std::nullopt;
+        }
+        if (ec != std::errc() || end != raw.data() + raw.size()) {
+            lexer.parsingError = "Invalid number " + raw;
+            return std::nullopt;
+        }
+    }
+    return literal;
+}
+
 std::unique_ptr<ExprAST> parseRHSExpr(Lexer& lexer) {
     std::unique_ptr<ExprAST> expr;
 
     if (lexer.curToken.type == TOK_VALUE) {
         // values
         lexer.pushDebugInfo();
-        expr = std::make_unique<ValueExprAST>(lexer.curToken.rawToken);
+        auto literal = parseLiteral(lexer);
+        if (!literal.has_value()) {
+            return nullptr;
+        }
+        expr = std::make_unique<ValueExprAST>(lexer.curToken.rawToken, std::move(*literal));
         lexer.consume();
         expr->setDebugInfo(lexer.popDebugInfo());
     } else if (lexer.curToken.type == TOK_IDENTIFIER) {
@@ -44,6 +107,9 @@ std::unique_ptr<ExprAST> parseRHSExpr(Lexer& lexer) {
         lexer.consume();
         expr = std::make_unique<VariableExprAST>(std::move(identifier));
         expr->setDebugInfo(lexer.popDebugInfo());
+    } else if (lexer.curToken.rawToken == KW_BUILTIN) {
+        // builtins
+        expr = parseBuiltin(lexer);
     } else if (lexer.curToken.rawToken == "(") {
         // parentheses
         // TODO: make this it's own ast node (for debuginfo purposes
@@ -53,22 +119,32 @@ std::unique_ptr<ExprAST> parseRHSExpr(Lexer& lexer) {
             return lexer.expected(")");
         }
         lexer.consume();
-    } else if (lexer.curToken.rawToken == "~") {
+    } else if (lexer.curToken.rawToken == "~" && startsConstructor(lexer)) {
         // constructor and arrays
-        // TODO: this collides with unop. figure it out
         if (lexer.peek(1).rawToken == "[") {
             expr = parseArray(lexer);
         } else {
             expr = parseConstructor(lexer);
         }
-    } else if (lexer.curToken.type == TOK_UNOP || lexer.curToken.rawToken == "-") {
+    } else if (lexer.curToken.type == TOK_UNOP || lexer.curToken.op == OP_SUB) {
         // unary ops
         // special case for - because it's a binop and a unop
         lexer.pushDebugInfo();
-        auto unOp = lexer.curToken.rawToken;
+        auto unOp = lexer.curToken.op == OP_SUB ? OP_NEG : lexer.curToken.op;
         lexer.consume();
-        expr = std::make_unique<UnaryOpExprAST>(parseRHSExpr(lexer), unOp);
-        expr->setDebugInfo(lexer.popDebugInfo());
+        auto operand = parseRHSExpr(lexer);
+        if (!operand) {
+            return nullptr;
+        }
+        // Negative number literals are literals themselves, so i.e. the minimum of a signed type can be written
+        auto* value = dynamic_cast<ValueExprAST*>(operand.get());
+        if (unOp == OP_NEG && value && value->negate()) {
+            expr = std::move(operand);
+            expr->setDebugInfo(lexer.popDebugInfo());
+        } else {
+            expr = std::make_unique<UnaryOpExprAST>(std::move(operand), unOp);
+            expr->setDebugInfo(lexer.popDebugInfo());
+        }
     } else {
         return lexer.expected("expression");
     }
@@ -95,55 +171,31 @@ std::unique_ptr<ExprAST> parseRHSExpr(Lexer& lexer) {
     return expr;
 }
 
-std::unique_ptr<ExprAST> parseExpr(Lexer& lexer) {
-    lexer.pushDebugInfo();
-    auto firstExpr = parseRHSExpr(lexer);
-    if (!firstExpr) {
+// Pratt parser: parses an operand, then keeps folding in binary operators that bind tighter than minPrecedence
+static std::unique_ptr<ExprAST> parseBinaryExpr(Lexer& lexer, const int minPrecedence) {
+    auto startToken = lexer.debugPosition();
+    auto LHS = parseRHSExpr(lexer);
+    if (!LHS) {
         return nullptr;
     }
 
-    std::vector<std::unique_ptr<ExprAST> > stack;
-    stack.push_back(std::move(firstExpr));
-    std::vector<std::string> opStack;
-    while (lexer.curToken.type == TOK_BINOP) {
-        auto op = lexer.curToken.rawToken;
+    while (lexer.curToken.type == TOK_BINOP && OPERATOR_PRECEDENCE[lexer.curToken.op] > minPrecedence) {
+        auto op = lexer.curToken.op;
         lexer.consume();
 
-        lexer.pushDebugInfo();
-        auto expr = parseRHSExpr(lexer);
-        if (!expr) {
+        // Binary operators are left associative, so the right side only takes operators that bind tighter
+        auto RHS = parseBinaryExpr(lexer, OPERATOR_PRECEDENCE[op]);
+        if (!RHS) {
             return nullptr;
         }
+        LHS = std::make_unique<BinaryOpExprAST>(std::move(LHS), std::move(RHS), op);
+        LHS->setDebugInfo(lexer.debugInfoFrom(startToken));
+    }
+    return LHS;
+}
 
-        while (opStack.size() > 0 && BINOPS.at(op) <= BINOPS.at(opStack.back())) {
-            auto RHS = std::move(stack.back());
-            stack.pop_back();
-            auto LHS = std::move(stack.back());
-            stack.pop_back();
-            auto binOp = opStack.back();
-            opStack.pop_back();
-            auto binExpr = std::make_unique<BinaryOpExprAST>(std::move(LHS), std::move(RHS), binOp);
-            lexer.popDebugInfo();
-            binExpr->setDebugInfo(lexer.popDebugInfo(false));
-            stack.push_back(std::move(binExpr));
-        }
-        stack.push_back(std::move(expr));
-        opStack.push_back(op);
-    }
-    while (opStack.size() > 0) {
-        auto RHS = std::move(stack.back());
-        stack.pop_back();
-        auto LHS = std::move(stack.back());
-        stack.pop_back();
-        auto binOp = opStack.back();
-        opStack.pop_back();
-        auto binExpr = std::make_unique<BinaryOpExprAST>(std::move(LHS), std::move(RHS), binOp);
-        lexer.popDebugInfo();
-        binExpr->setDebugInfo(lexer.popDebugInfo(false));
-        stack.push_back(std::move(binExpr));
-    }
-    lexer.popDebugInfo();
-    return std::move(stack.back());
+std::unique_ptr<ExprAST> parseExpr(Lexer& lexer) {
+    return parseBinaryExpr(lexer, 0);
 }
 
 std::unique_ptr<IfAST> parseIf(Lexer& lexer, const bool onIf) {
@@ -286,7 +338,7 @@ std::unique_ptr<VarAST> parseVar(Lexer& lexer) {
     if (lexer.curToken.type != TOK_VAROP) {
         return lexer.expected("variable assignment operator");
     }
-    auto varOp = lexer.curToken.rawToken;
+    auto varOp = lexer.curToken.op;
     lexer.consume();
 
     auto expr = parseExpr(lexer);
@@ -299,33 +351,69 @@ std::unique_ptr<VarAST> parseVar(Lexer& lexer) {
     return ast;
 }
 
-std::unique_ptr<CallExprAST> parseCall(Lexer& lexer, std::unique_ptr<ExprAST> callee) {
-    lexer.pushDebugInfo();
+static bool parseArgs(Lexer& lexer, std::vector<std::unique_ptr<ExprAST> >& args) {
     if (lexer.curToken.rawToken != "(") {
-        return lexer.expected("(");
+        lexer.expected("(");
+        return false;
     }
     lexer.consume();
 
-    std::vector<std::unique_ptr<ExprAST> > args;
     while (lexer.curToken.rawToken != ")") {
         auto expr = parseExpr(lexer);
         if (!expr) {
-            return nullptr;
+            return false;
         }
         args.push_back(std::move(expr));
         if (lexer.curToken.rawToken == ",") {
             lexer.consume();
         } else if (lexer.curToken.rawToken != ")") {
-            return lexer.expected(")");
+            lexer.expected(")");
+            return false;
         }
     }
     lexer.consume();
+    return true;
+}
+
+std::unique_ptr<CallExprAST> parseCall(Lexer& lexer, std::unique_ptr<ExprAST> callee) {
+    lexer.pushDebugInfo();
+    std::vector<std::unique_ptr<ExprAST> > args;
+    if (!parseArgs(lexer, args)) {
+        return nullptr;
+    }
 
     auto ast = std::make_unique<CallExprAST>(std::move(callee), std::move(args));
     ast->setDebugInfo(lexer.popDebugInfo());
     return ast;
 }
 
+std::unique_ptr<CallExprAST> parseBuiltin(Lexer& lexer) {
+    lexer.pushDebugInfo();
+    if (lexer.curToken.rawToken != KW_BUILTIN) {
+        return lexer.expected(KW_BUILTIN);
+    }
+    lexer.consume();
+    if (lexer.curToken.rawToken != ".") {
+        return lexer.expected(".");
+    }
+    lexer.consume();
+    // Builtins are resolved here, so an unknown name is a parsing error
+    auto builtin = lexer.curToken.type == TOK_IDENTIFIER ? findBuiltin(lexer.curToken.rawToken) : std::nullopt;
+    if (!builtin.has_value()) {
+        return lexer.expected("builtin name");
+    }
+    lexer.consume();
+
+    std::vector<std::unique_ptr<ExprAST> > args;
+    if (!parseArgs(lexer, args)) {
+        return nullptr;
+    }
+
+    auto ast = std::make_unique<CallExprAST>(builtin.value(), std::move(args));
+    ast->setDebugInfo(lexer.popDebugInfo());
+    return ast;
+}
+
 template<std::derived_from<ExprAST> T>
 std::unique_ptr<T> parseAccessor(Lexer& lexer, std::unique_ptr<T> expr) {
     if (lexer.curToken.rawToken == ".") {
@@ -341,9 +429,35 @@ std::unique_ptr<T> parseAccessor(Lexer& lexer, std::unique_ptr<T> expr) {
     } else if (lexer.curToken.rawToken == "[") {
         lexer.pushDebugInfo();
         lexer.consume();
-        auto indexExpr = parseExpr(lexer);
+        std::unique_ptr<ExprAST> indexExpr;
+        if (lexer.curToken.rawToken != ":") {
+            indexExpr = parseExpr(lexer);
+            if (!indexExpr) {
+                return nullptr;
+            }
+        }
+        // Slices are temporaries, so they can't start an assignment target
+        if constexpr (std::derived_from<SliceExprAST, T>) {
+            if (lexer.curToken.rawToken == ":") {
+                lexer.consume();
+                std::unique_ptr<ExprAST> endExpr;
+                if (lexer.curToken.rawToken != "]") {
+                    endExpr = parseExpr(lexer);
+                    if (!endExpr) {
+                        return nullptr;
+                    }
+                }
+                if (lexer.curToken.rawToken != "]") {
+                    return lexer.expected("]");
+                }
+                lexer.consume();
+                expr = std::make_unique<SliceExprAST>(std::move(expr), std::move(indexExpr), std::move(endExpr));
+                expr->setDebugInfo(lexer.popDebugInfo());
+                return expr;
+            }
+        }
         if (!indexExpr) {
-            return nullptr;
+            return lexer.expected("index expression");
         }
         if (lexer.curToken.rawToken != "]") {
             return lexer.expected("]");
@@ -604,6 +718,11 @@ std::unique_ptr<FuncAST> parseFunc(Lexer& lexer) {
 std::unique_ptr<StructAST> parseStruct(Lexer& lexer) {
     lexer.pushDebugInfo();
 
+    bool isInline = false;
+    if (lexer.curToken.rawToken == KW_INLINE) {
+        isInline = true;
+        lexer.consume();
+    }
     if (lexer.curToken.rawToken != KW_STRUCT) {
         return lexer.expected("struct");
     }
@@ -660,7 +779,7 @@ std::unique_ptr<StructAST> parseStruct(Lexer& lexer) {
     }
     lexer.consume();
 
-    auto ast = std::make_unique<StructAST>(structIdentifier, std::move(fields), std::move(methods));
+    auto ast = std::make_unique<StructAST>(structIdentifier, std::move(fields), std::move(methods), isInline);
     ast->setDebugInfo(lexer.popDebugInfo());
     return ast;
 }
@@ -708,13 +827,31 @@ std::unique_ptr<StatementAST> parseStatement(Lexer& lexer) {
 
 std::unique_ptr<TopLevelAST> parseTopLevel(Lexer& lexer) {
     lexer.startDebugStatement();
+    bool isExported = false;
+    if (lexer.curToken.rawToken == KW_EXPORT) {
+        isExported = true;
+        lexer.consume();
+    }
+
     std::unique_ptr<TopLevelAST> statement;
     if (lexer.curToken.rawToken == KW_FUNC ||
         (lexer.curToken.rawToken == KW_EXTERN &&
          lexer.peek(1).rawToken == KW_FUNC)) {
-        statement = parseFunc(lexer);
-    } else if (lexer.curToken.rawToken == KW_STRUCT) {
-        statement = parseStruct(lexer);
+        auto func = parseFunc(lexer);
+        if (func) {
+            func->isExported = isExported;
+        }
+        statement = std::move(func);
+    } else if (lexer.curToken.rawToken == KW_STRUCT ||
+               (lexer.curToken.rawToken == KW_INLINE &&
+                lexer.peek(1).rawToken == KW_STRUCT)) {
+        auto structAst = parseStruct(lexer);
+        if (structAst) {
+            structAst->isExported = isExported;
+        }
+        statement = std::move(structAst);
+    } else if (isExported) {
+        return lexer.expected("func or struct after export");
     } else if (lexer.curToken.rawToken == KW_FROM) {
         statement = parseImport(lexer);
     } else {
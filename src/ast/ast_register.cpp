@@ -4,17 +4,29 @@
 #include "module/generated.h"
 #include "module/module_config.h"
 #include "module/module_state.h"
+#include "timing.h"
 
 using namespace llvm;
 
 bool ImportAST::preregister(ModuleState& state, const std::string& unit) {
-    if (!state.registerUnit(this->unit)) {
+    if (!state.registerImport(unit, this->unit)) {
         state.setError(this->debugInfo, "Could not import unit " + unit);
         return false;
     }
     return true;
 }
 
+bool ImportAST::registerTypes(ModuleState& state, const std::string& unit) {
+    for (const auto& [identifier, alias]: aliases) {
+        // Every imported name is registered (not only inline structs), so the unit's own names shadow other units'
+        if (!state.registerStructType(unit, alias, state.getInlineStructType(this->unit, identifier))) {
+            state.setError(this->debugInfo, "Duplicate identifier " + alias);
+            return false;
+        }
+    }
+    return true;
+}
+
 bool ImportAST::postregister(ModuleState& state, const std::string& unit) {
     for (const auto& [identifier, alias]: aliases) {
         if (!state.useGlobalIdentifier(this->unit, identifier, alias)) {
@@ -38,6 +50,15 @@ std::shared_ptr<GeneratedValue> FuncAST::declare(const ModuleState& state, const
                                       Function::ExternalLinkage,
                                       twine,
                                       state.module.get());
+    if (!isExtern) {
+        // Axon has no exceptions
+        function->addFnAttr(Attribute::NoUnwind);
+        // Nothing outside the module can call this, so LLVM is free to change its convention, inline or drop it
+        if (!isExported && twine != "main" && state.singleModule()) {
+            function->setLinkage(Function::InternalLinkage);
+            function->setCallingConv(CallingConv::Fast);
+        }
+    }
     auto genFunction = std::make_shared<GeneratedValue>(GeneratedType::get(functionType), function);
     declaration = genFunction;
     return genFunction;
@@ -52,6 +73,9 @@ bool FuncAST::preregister(ModuleState& state, const std::string& unit) {
     }
 
     auto genFunction = declare(state, twine);
+    if (!isExtern) {
+        state.deferBody(unit, genFunction->value, this, isExported || twine == "main");
+    }
     if (!state.registerGlobalIdentifier(unit,
                                         funcName,
                                         std::make_unique<Identifier>(std::move(*genFunction)))) {
@@ -69,10 +93,36 @@ bool FuncAST::postregister(ModuleState& state, const std::string& unit) {
     return true;
 }
 
+bool StructAST::registerType(ModuleState& state, const std::string& unit) {
+    structType = StructType::create(*state.ctx, unit + "." + structName);
+    if (!state.registerStructType(unit, structName, isInline ? structType : nullptr)) {
+        state.setError(this->debugInfo, "Duplicate identifier " + structName);
+        return false;
+    }
+    return true;
+}
+
+// Whether holder contains target by value, directly or through the inline structs it contains
+static bool holdsInline(StructType* holder, StructType* target) {
+    for (auto* element: holder->elements()) {
+        auto* elementStruct = dyn_cast<StructType>(element);
+        if (elementStruct && (elementStruct == target || holdsInline(elementStruct, target))) {
+            return true;
+        }
+    }
+    return false;
+}
+
 bool StructAST::preregister(ModuleState& state, const std::string& unit) {
     std::unordered_map<std::string, std::shared_ptr<GeneratedValue> > generatedMethods;
     for (const auto& [methodName, method]: methods) {
+        if (method->isExtern) {
+            state.setError(this->debugInfo, "Structs cannot have extern methods");
+            return false;
+        }
+        method->isExported = isExported;
         generatedMethods[methodName] = method->declare(state, unit + "." + structName + "." + methodName);
+        state.deferBody(unit, generatedMethods[methodName]->value, method.get(), isExported);
     }
 
     auto elements = std::vector<Type*>();
@@ -80,16 +130,25 @@ bool StructAST::preregister(ModuleState& state, const std::string& unit) {
         elements.push_back(fieldType->getLLVMType(state));
     }
     // TODO: I don't think llvm does padding / alignment, so we have to do it ourselves
-    auto* structType = StructType::create(*state.ctx, elements, unit + "." + structName);
+    assert(structType && "struct type not registered");
+    structType->setBody(elements);
+    // An inline struct holding itself would be infinitely large. Whichever struct of a cycle gets its body last
+    // finds it, since the others already have theirs.
+    if (isInline && holdsInline(structType, structType)) {
+        state.setError(this->debugInfo,
+                       "Inline struct " + structName + " cannot contain itself by value; use a non-inline struct");
+        return false;
+    }
 
     if (!state.registerGlobalIdentifier(unit,
                                         structName,
                                         std::make_unique<Identifier>(
                                             GeneratedStruct(
                                                 GeneratedType::get(TypeBacker(structName, true)),
-                                                std::move(fields),
+                                                fields,
                                                 std::move(generatedMethods),
-                                                structType)))) {
+                                                structType,
+                                                isInline)))) {
         state.setError(this->debugInfo, "Duplicate identifier " + structName);
         return false;
     }
@@ -137,8 +196,35 @@ bool VarAST::postregister(ModuleState& state, const std::string& unit) {
 }
 
 
+bool UnitAST::registerTypes(ModuleState& state) {
+    PhaseTimer timer("register types", unit);
+    for (const auto& statement: statements) {
+        // Imports are registered here too, so the units they bring in get their types registered in the same pass
+        if (auto* import = dynamic_cast<ImportAST*>(statement.get())) {
+            if (!import->preregister(state, unit)) {
+                return false;
+            }
+        } else if (auto* structAst = dynamic_cast<StructAST*>(statement.get())) {
+            if (!structAst->registerType(state, unit)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
 bool UnitAST::preregisterUnit(ModuleState& state) {
+    PhaseTimer timer("preregister", unit);
+    state.enterTypeUnit(unit);
     for (const auto& statement: statements) {
+        // The imported units are loaded by now, so aliases of their inline structs can be resolved before any
+        // declaration of this unit needs their LLVM type
+        if (auto* import = dynamic_cast<ImportAST*>(statement.get())) {
+            if (!import->registerTypes(state, unit)) {
+                return false;
+            }
+            continue;
+        }
         if (!statement->preregister(state, unit)) {
             return false;
         }
@@ -1,15 +1,42 @@
+#include <atomic>
 #include <sstream>
 #include <llvm/Support/raw_ostream.h>
 
 #include "ast.h"
+#include "lexer/lexer.h"
 #include "module/generated.h"
 
+static std::atomic<size_t> astLiveNodes = 0;
+static std::atomic<size_t> astLiveBytes = 0;
+
+void* AST::operator new(const size_t size) {
+    astLiveNodes += 1;
+    astLiveBytes += size;
+    return ::operator new(size);
+}
+
+void AST::operator delete(void* ptr, const size_t size) {
+    astLiveNodes -= 1;
+    astLiveBytes -= size;
+    ::operator delete(ptr, size);
+}
+
+size_t AST::liveNodes() {
+    return astLiveNodes;
+}
+
+size_t AST::liveBytes() {
+    return astLiveBytes;
+}
+
 std::string GeneratedType::toString() {
     std::string str;
     if (isBase()) {
         str = std::get<std::string>(type.backer);
     } else if (isArray()) {
         str = std::get<GeneratedType*>(type.backer)->toString() + "[]";
+    } else if (isVector()) {
+        str = getVectorElement()->toString() + "x" + std::to_string(getVectorLanes());
     } else if (isFunction()) {
         std::ostringstream result;
         result << "((";
@@ -36,16 +63,37 @@ std::string ValueExprAST::toString() {
     return rawValue;
 }
 
+bool ValueExprAST::isConstant() {
+    return literal.kind != LITERAL_STRING;
+}
+
+bool ValueExprAST::negate() {
+    if (literal.kind != LITERAL_INT && literal.kind != LITERAL_FLOAT) {
+        return false;
+    }
+    literal.negative = !literal.negative;
+    rawValue = "-" + rawValue;
+    return true;
+}
+
 std::string VariableExprAST::toString() {
     return varName;
 }
 
 std::string BinaryOpExprAST::toString() {
-    return LHS->toString() + " " + binOp + " " + RHS->toString();
+    return LHS->toString() + " " + std::string(operatorString(binOp)) + " " + RHS->toString();
 }
 
 std::string UnaryOpExprAST::toString() {
-    return unaryOp + expr->toString();
+    return std::string(operatorString(unaryOp)) + expr->toString();
+}
+
+bool BinaryOpExprAST::isConstant() {
+    return LHS->isConstant() && RHS->isConstant();
+}
+
+bool UnaryOpExprAST::isConstant() {
+    return expr->isConstant();
 }
 
 std::string CallExprAST::toString() {
@@ -56,7 +104,8 @@ std::string CallExprAST::toString() {
             result << ", ";
         }
     }
-    return callee->toString() + "(" + result.str() + ")";
+    auto name = callee ? callee->toString() : KW_BUILTIN + "." + std::string(BUILTIN_NAMES[builtin]);
+    return name + "(" + result.str() + ")";
 }
 
 std::string MemberAccessExprAST::toString() {
@@ -67,6 +116,11 @@ std::string SubscriptExprAST::toString() {
     return arrayExpr->toString() + "[" + indexExpr->toString() + "]";
 }
 
+std::string SliceExprAST::toString() {
+    return arrayExpr->toString() + "[" + (startExpr ? startExpr->toString() : "") + ":" +
+           (endExpr ? endExpr->toString() : "") + "]";
+}
+
 std::string ConstructorExprAST::toString() {
     std::ostringstream result;
     for (const auto& [fieldName, fieldValue]: values) {
@@ -108,7 +162,8 @@ std::string FuncAST::toString() {
             result << ", ";
         }
     }
-    auto sig = "func " + funcName + "(" + result.str() + "): " + returnType->toString();
+    auto sig = std::string(isExported ? "export " : "") + "func " + funcName + "(" + result.str() + "): " +
+               returnType->toString();
     if (isExtern) {
         return "extern " + sig;
     } else {
@@ -124,14 +179,15 @@ std::string StructAST::toString() {
             result << ", ";
         }
     }
-    return "struct " + structName + " {" + result.str() + "}";
+    return std::string(isExported ? "export " : "") + (isInline ? "inline " : "") + "struct " + structName + " {" +
+           result.str() + "}";
 }
 
 std::string VarAST::toString() {
     return (definition ? "let " : "") +
            variableExpr->toString() +
            (type.has_value() ? ": " + type.value()->toString() : "") +
-           " = " + expr->toString();
+           " " + std::string(operatorString(varOp)) + " " + expr->toString();
 }
 
 std::string IfAST::toString() {
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+// Builtins are called as builtin.<name>(args) and lowered straight to LLVM instructions and intrinsics
+
+#define X_BUILTIN \
+    /* bits */ \
+    BUILTIN(POPCOUNT, "popcount") \
+    BUILTIN(CTLZ, "ctlz") \
+    BUILTIN(CTTZ, "cttz") \
+    BUILTIN(BSWAP, "bswap") \
+    BUILTIN(ROTL, "rotl") \
+    BUILTIN(ROTR, "rotr") \
+    /* math */ \
+    BUILTIN(SQRT, "sqrt") \
+    BUILTIN(FMA, "fma") \
+    BUILTIN(MIN, "min") \
+    BUILTIN(MAX, "max") \
+    BUILTIN(ABS, "abs") \
+    /* memory */ \
+    BUILTIN(MEMCPY, "memcpy") \
+    BUILTIN(MEMMOVE, "memmove") \
+    BUILTIN(MEMSET, "memset") \
+    BUILTIN(PREFETCH, "prefetch") \
+    /* hints */ \
+    BUILTIN(EXPECT, "expect") \
+    /* vectors */ \
+    BUILTIN(SPLAT, "splat") \
+    BUILTIN(SHUFFLE, "shuffle") \
+    BUILTIN(SELECT, "select") \
+    BUILTIN(REDUCE_ADD, "reduce_add") \
+    BUILTIN(REDUCE_MUL, "reduce_mul") \
+    BUILTIN(REDUCE_MIN, "reduce_min") \
+    BUILTIN(REDUCE_MAX, "reduce_max") \
+    BUILTIN(REDUCE_AND, "reduce_and") \
+    BUILTIN(REDUCE_OR, "reduce_or") \
+    BUILTIN(REDUCE_XOR, "reduce_xor")
+
+enum BuiltinKind : uint8_t {
+#define BUILTIN(NAME, STR) BUILTIN_##NAME,
+    X_BUILTIN
+#undef BUILTIN
+    BUILTIN_NONE,
+};
+
+inline constexpr size_t BUILTIN_COUNT = BUILTIN_NONE;
+
+inline constexpr std::array<std::string_view, BUILTIN_COUNT> BUILTIN_NAMES{
+#define BUILTIN(NAME, STR) STR,
+    X_BUILTIN
+#undef BUILTIN
+};
+
+constexpr std::optional<BuiltinKind> findBuiltin(const std::string_view name) {
+    for (size_t builtin = 0; builtin < BUILTIN_COUNT; builtin++) {
+        if (BUILTIN_NAMES[builtin] == name) {
+            return static_cast<BuiltinKind>(builtin);
+        }
+    }
+    return std::nullopt;
+}
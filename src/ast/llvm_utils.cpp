@@ -8,6 +8,7 @@
 
 #include "ast/ast.h"
 #include "module/generated.h"
+#include "module/module_config.h"
 #include "module/module_state.h"
 
 using namespace llvm;
@@ -28,14 +29,30 @@ std::string typeToString(const Type* type) {
 }
 
 // This is (mostly) copied from IRBuidler's CreateMallocCall function
-CallInst* createMalloc(ModuleState& state, Value* allocSize, const std::string& name) {
+CallInst* createMalloc(ModuleState& state,
+                       Value* allocSize,
+                       const std::string& name,
+                       GeneratedType* type,
+                       const DebugInfo& debugInfo) {
     assert(allocSize->getType() == state.sizeTy && "malloc size is wrong type");
 
     // TODO: free!!!!
     // TODO: insert function in state and store it there (w/ module option for nomalloc / nostdlib)
-    // void* malloc(size_t amount);
-    auto mallocFunc = state.module->getOrInsertFunction("malloc", PointerType::getUnqual(*state.ctx), state.sizeTy);
-    auto mallocCall = state.builder->CreateCall(mallocFunc, allocSize, name + "_malloc");
+    CallInst* mallocCall;
+    FunctionCallee mallocFunc;
+    if (state.config.allocProfile) {
+        // void* __axon_alloc(size_t amount, uint32_t site); see runtime/alloc_profile.c
+        mallocFunc = state.module->getOrInsertFunction("__axon_alloc",
+                                                       PointerType::getUnqual(*state.ctx),
+                                                       state.sizeTy,
+                                                       state.builder->getInt32Ty());
+        auto* site = state.builder->getInt32(state.registerAllocSite(type, debugInfo));
+        mallocCall = state.builder->CreateCall(mallocFunc, {allocSize, site}, name + "_malloc");
+    } else {
+        // void* malloc(size_t amount);
+        mallocFunc = state.module->getOrInsertFunction("malloc", PointerType::getUnqual(*state.ctx), state.sizeTy);
+        mallocCall = state.builder->CreateCall(mallocFunc, allocSize, name + "_malloc");
+    }
     mallocCall->setTailCall();
     if (Function* F = dyn_cast<Function>(mallocFunc.getCallee())) {
         mallocCall->setCallingConv(F->getCallingConv());
@@ -11,11 +11,17 @@ using namespace llvm;
 class ModuleState;
 
 struct GeneratedType;
+struct DebugInfo;
 
 std::vector<Value*> createFieldIndices(const ModuleState& state, const int index);
 
 std::string typeToString(const Type* type);
 
-CallInst* createMalloc(ModuleState& state, Value* allocSize, const std::string& name);
+// Allocates a value of the given type; with --alloc-profile the allocation is attributed to its source location
+CallInst* createMalloc(ModuleState& state,
+                       Value* allocSize,
+                       const std::string& name,
+                       GeneratedType* type,
+                       const DebugInfo& debugInfo);
 
 Value* createArrayFatPointer(const ModuleState& state, Value* arrayPointer, const int length);
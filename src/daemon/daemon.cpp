@@ -0,0 +1,243 @@
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <ranges>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <llvm/Support/raw_ostream.h>
+
+#include "daemon.h"
+#include "logging.h"
+
+// Client stdin, stdout and stderr
+static constexpr int FORWARDED_FDS = 3;
+
+std::filesystem::path defaultDaemonSocket() {
+    if (auto* runtimeDir = std::getenv("XDG_RUNTIME_DIR")) {
+        return std::filesystem::path(runtimeDir) / "axon.sock";
+    }
+    return std::filesystem::temp_directory_path() / ("axon-" + std::to_string(getuid()) + ".sock");
+}
+
+static bool setSocketPath(sockaddr_un& address, const std::filesystem::path& socketPath) {
+    address = {};
+    address.sun_family = AF_UNIX;
+    auto path = socketPath.string();
+    if (path.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+static bool writeAll(const int fd, const void* data, size_t size) {
+    auto* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        auto written = write(fd, bytes, size);
+        if (written <= 0) {
+            return false;
+        }
+        bytes += written;
+        size -= written;
+    }
+    return true;
+}
+
+static bool readAll(const int fd, void* data, size_t size) {
+    auto* bytes = static_cast<char*>(data);
+    while (size > 0) {
+        auto received = read(fd, bytes, size);
+        if (received <= 0) {
+            return false;
+        }
+        bytes += received;
+        size -= received;
+    }
+    return true;
+}
+
+// Request layout: a 4 byte payload size sent together with the client's stdio fds, then the payload, which is the
+// working directory followed by every argument, each null terminated.
+static bool sendRequest(const int socket, const std::string& payload) {
+    uint32_t size = payload.size();
+    iovec iov{&size, sizeof(size)};
+
+    char control[CMSG_SPACE(sizeof(int) * FORWARDED_FDS)] = {};
+    msghdr message{};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    auto* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int) * FORWARDED_FDS);
+    int fds[FORWARDED_FDS] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+    std::memcpy(CMSG_DATA(header), fds, sizeof(fds));
+
+    if (sendmsg(socket, &message, 0) != sizeof(size)) {
+        return false;
+    }
+    return writeAll(socket, payload.data(), payload.size());
+}
+
+static bool receiveRequest(const int socket, int fds[FORWARDED_FDS], std::vector<std::string>& strings) {
+    uint32_t size;
+    iovec iov{&size, sizeof(size)};
+
+    char control[CMSG_SPACE(sizeof(int) * FORWARDED_FDS)] = {};
+    msghdr message{};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    if (recvmsg(socket, &message, 0) != sizeof(size)) {
+        return false;
+    }
+    auto* header = CMSG_FIRSTHDR(&message);
+    if (!header || header->cmsg_type != SCM_RIGHTS || header->cmsg_len != CMSG_LEN(sizeof(int) * FORWARDED_FDS)) {
+        return false;
+    }
+    std::memcpy(fds, CMSG_DATA(header), sizeof(int) * FORWARDED_FDS);
+
+    std::string payload(size, '\0');
+    if (!readAll(socket, payload.data(), payload.size())) {
+        return false;
+    }
+    size_t start = 0;
+    while (start < payload.size()) {
+        auto end = payload.find('\0', start);
+        strings.push_back(payload.substr(start, end - start));
+        start = end + 1;
+    }
+    return strings.size() >= 2;
+}
+
+static void flushOutput() {
+    std::cout.flush();
+    std::cerr.flush();
+    llvm::outs().flush();
+    llvm::errs().flush();
+}
+
+static int serveRequest(const int client, const BuildFunction& build) {
+    int fds[FORWARDED_FDS];
+    std::vector<std::string> strings;
+    if (!receiveRequest(client, fds, strings)) {
+        logError("Daemon received a malformed request");
+        return -1;
+    }
+
+    auto oldCwd = std::filesystem::current_path();
+    std::error_code ec;
+    std::filesystem::current_path(strings[0], ec);
+
+    // Point our own stdio at the client's for the duration of the build
+    int savedFds[FORWARDED_FDS];
+    for (int i = 0; i < FORWARDED_FDS; i++) {
+        savedFds[i] = dup(i);
+        dup2(fds[i], i);
+        close(fds[i]);
+    }
+
+    int exitCode;
+    if (ec) {
+        std::cerr << "Could not enter " << strings[0] << ": " << ec.message() << std::endl;
+        exitCode = 1;
+    } else {
+        std::vector<char*> argv;
+        for (auto& arg: strings | std::views::drop(1)) {
+            argv.push_back(arg.data());
+        }
+        argv.push_back(nullptr);
+        exitCode = build(static_cast<int>(argv.size() - 1), argv.data());
+    }
+
+    flushOutput();
+    for (int i = 0; i < FORWARDED_FDS; i++) {
+        dup2(savedFds[i], i);
+        close(savedFds[i]);
+    }
+    std::filesystem::current_path(oldCwd, ec);
+    return exitCode;
+}
+
+int runDaemon(const std::filesystem::path& socketPath, const BuildFunction& build) {
+    sockaddr_un address;
+    if (!setSocketPath(address, socketPath)) {
+        logError("Socket path too long: " + socketPath.string());
+        return 1;
+    }
+
+    auto server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0) {
+        logError(std::string("Could not create socket: ") + std::strerror(errno));
+        return 1;
+    }
+    // A socket file left behind by a daemon that didn't shut down cleanly would make bind fail
+    unlink(address.sun_path);
+    if (bind(server, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(server, 16) < 0) {
+        logError("Could not listen on " + socketPath.string() + ": " + std::strerror(errno));
+        close(server);
+        return 1;
+    }
+    // Clients that go away mid-build shouldn't take the daemon down with them
+    std::signal(SIGPIPE, SIG_IGN);
+    std::cerr << "Axon daemon listening on " << socketPath.string() << std::endl;
+
+    while (true) {
+        auto client = accept(server, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            logError(std::string("Could not accept connection: ") + std::strerror(errno));
+            break;
+        }
+        int32_t exitCode = serveRequest(client, build);
+        if (exitCode >= 0) {
+            writeAll(client, &exitCode, sizeof(exitCode));
+        }
+        close(client);
+    }
+    close(server);
+    unlink(address.sun_path);
+    return 1;
+}
+
+std::optional<int> runDaemonClient(const std::filesystem::path& socketPath, const int argc, char* argv[]) {
+    sockaddr_un address;
+    if (!setSocketPath(address, socketPath)) {
+        return std::nullopt;
+    }
+    auto daemon = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (daemon < 0) {
+        return std::nullopt;
+    }
+    if (connect(daemon, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        close(daemon);
+        return std::nullopt;
+    }
+
+    std::error_code ec;
+    auto payload = std::filesystem::current_path(ec).string();
+    payload.push_back('\0');
+    for (int i = 0; i < argc; i++) {
+        payload += argv[i];
+        payload.push_back('\0');
+    }
+
+    int32_t exitCode;
+    if (!sendRequest(daemon, payload) || !readAll(daemon, &exitCode, sizeof(exitCode))) {
+        close(daemon);
+        logWarning("Lost connection to the daemon at " + socketPath.string());
+        return 1;
+    }
+    close(daemon);
+    return exitCode;
+}
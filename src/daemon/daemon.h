@@ -0,0 +1,21 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <optional>
+
+/// A long lived compiler process that builds on behalf of thin clients over a Unix domain socket.
+/// Clients send their working directory and arguments along with their stdio file descriptors, so the build writes
+/// straight to the client's terminal (or pipes) and only the exit code is sent back.
+/// Builds run one at a time in the daemon process, which keeps the unit cache, the type table and LLVM's own global
+/// state warm between builds.
+using BuildFunction = std::function<int(int argc, char* argv[])>;
+
+// Socket used when AXON_DAEMON isn't set
+std::filesystem::path defaultDaemonSocket();
+
+// Serves builds until killed. Returns an exit code if the socket can't be set up.
+int runDaemon(const std::filesystem::path& socketPath, const BuildFunction& build);
+
+// Runs the build in the daemon listening on socketPath and returns its exit code, or nullopt if there's no daemon
+std::optional<int> runDaemonClient(const std::filesystem::path& socketPath, int argc, char* argv[]);
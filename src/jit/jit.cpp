@@ -0,0 +1,174 @@
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/Support/TargetSelect.h>
+
+#include "jit.h"
+#include "logging.h"
+#include "timing.h"
+#include "module/module_config.h"
+#include "module/module_state.h"
+
+using namespace llvm;
+
+AxonJIT::AxonJIT(std::unique_ptr<orc::LLJIT> jit, const ModuleConfig& config): jit(std::move(jit)), config(config) {
+    // Every module that reaches the compile layer goes through here; in lazy mode that's one per called function
+    this->jit->getIRTransformLayer().setTransform(
+        [this](orc::ThreadSafeModule tsm, orc::MaterializationResponsibility&) -> Expected<orc::ThreadSafeModule> {
+            tsm.withModuleDo([this](Module& module) {
+                for (const auto& function: module) {
+                    if (!function.isDeclaration()) {
+                        compiledFunctions += 1;
+                    }
+                }
+                if (this->config.lazyJIT) {
+                    PhaseTimer timer("optimize");
+                    ModuleState::optimizeModule(module, this->config);
+                }
+            });
+            return std::move(tsm);
+        });
+}
+
+AxonJIT::~AxonJIT() = default;
+
+std::unique_ptr<AxonJIT> AxonJIT::create(const ModuleConfig& config) {
+    InitializeNativeTarget();
+    InitializeNativeTargetAsmPrinter();
+
+    // LLLazyJIT splits modules per function and emits call-through stubs, so bodies only compile when first called
+    Expected<std::unique_ptr<orc::LLJIT> > jit = config.lazyJIT
+                                                     ? Expected<std::unique_ptr<orc::LLJIT> >(
+                                                         orc::LLLazyJITBuilder().create())
+                                                     : orc::LLJITBuilder().create();
+    if (!jit) {
+        logError("Could not create JIT: " + toString(jit.takeError()));
+        return nullptr;
+    }
+
+    // Resolve externs against the compiler process itself
+    auto processSymbols = orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+        (*jit)->getDataLayout().getGlobalPrefix());
+    if (!processSymbols) {
+        logError("Could not load process symbols: " + toString(processSymbols.takeError()));
+        return nullptr;
+    }
+    (*jit)->getMainJITDylib().addGenerator(std::move(*processSymbols));
+
+    return std::unique_ptr<AxonJIT>(new AxonJIT(std::move(*jit), config));
+}
+
+bool AxonJIT::addModule(ModuleState& state) {
+    if (auto* mainFunction = state.module->getFunction("main")) {
+        auto* returnType = mainFunction->getReturnType();
+        if (!returnType->isVoidTy() && !returnType->isIntegerTy(32)) {
+            logError("main must return int or void to be run");
+            return false;
+        }
+        mainReturnsInt = returnType->isIntegerTy(32);
+    }
+
+    state.module->setDataLayout(jit->getDataLayout());
+    state.module->setTargetTriple(jit->getTargetTriple().str());
+    return addThreadSafeModule(orc::ThreadSafeModule(std::move(state.module), std::move(state.ctx)));
+}
+
+bool AxonJIT::addIncrementalModule(const Module& module) {
+    // ORC needs to own the context of every module it's given, but the state keeps using its context for the next
+    // entry, so round trip through bitcode into a fresh one. Entries are small enough that this is cheap.
+    SmallVector<char, 0> buffer;
+    raw_svector_ostream stream(buffer);
+    WriteBitcodeToFile(module, stream);
+
+    auto ctx = std::make_unique<LLVMContext>();
+    auto copy = parseBitcodeFile(MemoryBufferRef(StringRef(buffer.data(), buffer.size()), module.getName()), *ctx);
+    if (!copy) {
+        logError("Could not copy module for JIT: " + toString(copy.takeError()));
+        return false;
+    }
+    (*copy)->setDataLayout(jit->getDataLayout());
+    (*copy)->setTargetTriple(jit->getTargetTriple().str());
+    if (!config.lazyJIT) {
+        PhaseTimer timer("optimize");
+        ModuleState::optimizeModule(**copy, config);
+    }
+    return addThreadSafeModule(orc::ThreadSafeModule(std::move(*copy), std::move(ctx)));
+}
+
+bool AxonJIT::addThreadSafeModule(orc::ThreadSafeModule tsm) {
+    tsm.withModuleDo([this](const Module& module) {
+        for (const auto& function: module) {
+            if (!function.isDeclaration()) {
+                definedFunctions += 1;
+            }
+        }
+    });
+
+    auto err = config.lazyJIT
+                   ? static_cast<orc::LLLazyJIT&>(*jit).addLazyIRModule(std::move(tsm))
+                   : jit->addIRModule(std::move(tsm));
+    if (err) {
+        logError("Could not add module to JIT: " + toString(std::move(err)));
+        return false;
+    }
+    return true;
+}
+
+std::optional<int> AxonJIT::runMain() {
+    orc::ExecutorAddr mainAddr;
+    {
+        // Looking up main is what actually triggers compilation
+        PhaseTimer timer("jit compile");
+        if (auto err = jit->initialize(jit->getMainJITDylib())) {
+            logError("Could not initialize JIT: " + toString(std::move(err)));
+            return std::nullopt;
+        }
+        auto mainSymbol = jit->lookup("main");
+        if (!mainSymbol) {
+            logError("Could not find main: " + toString(mainSymbol.takeError()));
+            return std::nullopt;
+        }
+        mainAddr = *mainSymbol;
+    }
+
+    int exitCode = 0;
+    {
+        PhaseTimer timer("run");
+        if (mainReturnsInt) {
+            exitCode = mainAddr.toPtr<int (*)()>()();
+        } else {
+            mainAddr.toPtr<void (*)()>()();
+        }
+    }
+    if (auto err = jit->deinitialize(jit->getMainJITDylib())) {
+        logError("Could not deinitialize JIT: " + toString(std::move(err)));
+    }
+    return exitCode;
+}
+
+bool AxonJIT::runFunction(const std::string& name) {
+    orc::ExecutorAddr address;
+    {
+        PhaseTimer timer("jit compile");
+        auto symbol = jit->lookup(name);
+        if (!symbol) {
+            logError("Could not find " + name + ": " + toString(symbol.takeError()));
+            return false;
+        }
+        address = *symbol;
+    }
+
+    PhaseTimer timer("run");
+    address.toPtr<void (*)()>()();
+    return true;
+}
+
+size_t AxonJIT::materializedFunctions() const {
+    return compiledFunctions;
+}
+
+size_t AxonJIT::totalFunctions() const {
+    return definedFunctions;
+}
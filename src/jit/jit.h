@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <string>
+
+namespace llvm {
+    class Module;
+}
+
+namespace llvm::orc {
+    class LLJIT;
+    class ThreadSafeModule;
+}
+
+using namespace llvm;
+
+class ModuleConfig;
+class ModuleState;
+
+/// In-process execution of compiled Axon modules using ORC.
+/// Extern functions are resolved against the host process, so anything linked into the compiler (i.e. libc)
+/// is callable from jitted code.
+/// In lazy mode every function is compiled (and optimized) on its first call through a stub, so startup time scales
+/// with the code that actually runs rather than with program size.
+class AxonJIT {
+    std::unique_ptr<orc::LLJIT> jit;
+    const ModuleConfig& config;
+    bool mainReturnsInt = false;
+
+    size_t definedFunctions = 0;
+    std::atomic<size_t> compiledFunctions = 0;
+
+    explicit AxonJIT(std::unique_ptr<orc::LLJIT> jit, const ModuleConfig& config);
+
+    bool addThreadSafeModule(orc::ThreadSafeModule tsm);
+
+public:
+    ~AxonJIT();
+
+    // Returns nullptr (after logging the error) if the host target can't be jitted
+    static std::unique_ptr<AxonJIT> create(const ModuleConfig& config);
+
+    // Takes ownership of the module and context of the given state; the state can't be used for codegen afterward.
+    bool addModule(ModuleState& state);
+
+    // Adds one module of an incrementally compiled program (i.e. a repl entry). The module is copied into a context of
+    // its own, so the caller keeps ownership and can keep referring to its declarations.
+    bool addIncrementalModule(const Module& module);
+
+    // Calls main and returns its exit code (0 for void mains)
+    std::optional<int> runMain();
+
+    // Calls a `void()` function from any added module
+    bool runFunction(const std::string& name);
+
+    // Number of function bodies that were actually compiled, out of all defined functions
+    size_t materializedFunctions() const;
+
+    size_t totalFunctions() const;
+};
@@ -0,0 +1,166 @@
+#include <iostream>
+
+#include "repl.h"
+#include "jit.h"
+#include "logging.h"
+#include "utils.h"
+#include "ast/ast.h"
+#include "lexer/lexer.h"
+#include "module/generated.h"
+#include "module/module_config.h"
+#include "module/module_state.h"
+
+static const std::string REPL_UNIT = "repl";
+static const std::string REPL_FILE = "<stdin>";
+
+struct ReplEntry {
+    std::vector<std::unique_ptr<TopLevelAST> > definitions;
+    std::vector<std::unique_ptr<StatementAST> > statements;
+};
+
+static bool isDefinition(Lexer& lexer) {
+    const auto& token = lexer.curToken.rawToken;
+    return token == KW_FUNC || token == KW_EXTERN || token == KW_EXPORT || token == KW_STRUCT || token == KW_INLINE ||
+           token == KW_FROM;
+}
+
+static std::optional<ReplEntry> parseEntry(Lexer& lexer) {
+    ReplEntry entry;
+    while (lexer.curToken.rawToken != std::string(1, EOF)) {
+        if (lexer.curToken.type == TOK_DELIMITER) {
+            lexer.consume();
+            continue;
+        }
+        if (isDefinition(lexer)) {
+            auto definition = parseTopLevel(lexer);
+            if (!definition) {
+                return std::nullopt;
+            }
+            entry.definitions.push_back(std::move(definition));
+        } else {
+            lexer.startDebugStatement();
+            auto statement = parseStatement(lexer);
+            if (!statement) {
+                return std::nullopt;
+            }
+            entry.statements.push_back(std::move(statement));
+        }
+    }
+    return entry;
+}
+
+// Codegens an entry into the current module; statements end up in a void function called entryFunction
+static bool compileEntry(ModuleState& state, Lexer& lexer, ReplEntry& entry, const std::string& entryFunction) {
+    auto fail = [&]() {
+        logError(state.formatBuildError(lexer, REPL_UNIT, REPL_FILE));
+        return false;
+    };
+
+    state.enterTypeUnit(REPL_UNIT);
+    for (const auto& definition: entry.definitions) {
+        auto* structAst = dynamic_cast<StructAST*>(definition.get());
+        if (structAst && !structAst->registerType(state, REPL_UNIT)) {
+            return fail();
+        }
+    }
+    for (const auto& definition: entry.definitions) {
+        if (!definition->preregister(state, REPL_UNIT)) {
+            return fail();
+        }
+    }
+    // Imports only register their units, so compile any new ones before using them (logs its own errors)
+    if (!state.compileUnits()) {
+        return false;
+    }
+    // Compiling imported units resolved types in those units
+    state.enterTypeUnit(REPL_UNIT);
+    for (const auto& definition: entry.definitions) {
+        auto* import = dynamic_cast<ImportAST*>(definition.get());
+        if (import && !import->registerTypes(state, REPL_UNIT)) {
+            return fail();
+        }
+    }
+    for (const auto& definition: entry.definitions) {
+        if (!definition->postregister(state, REPL_UNIT)) {
+            return fail();
+        }
+    }
+    for (const auto& definition: entry.definitions) {
+        if (!definition->codegen(state)) {
+            return fail();
+        }
+    }
+    if (entry.statements.empty()) {
+        return true;
+    }
+
+    auto wrapper = std::make_unique<FuncAST>(std::vector<SigArg>(),
+                                             GeneratedType::rawGet(KW_VOID),
+                                             std::make_unique<BlockAST>(std::move(entry.statements)),
+                                             entryFunction,
+                                             false,
+                                             false);
+    if (!wrapper->preregister(state, REPL_UNIT)) {
+        return fail();
+    }
+    // The wrapper's block is one scope deeper than the repl's own; variables defined there have to outlive the entry
+    state.globalVarDepth = state.scopeStack.size() + 1;
+    auto success = wrapper->codegen(state);
+    state.globalVarDepth.reset();
+    return success || fail();
+}
+
+// Undoes everything a failed entry registered, so the next entry starts from the last good state
+static void discardEntry(ModuleState& state, const std::string& nextModule) {
+    while (state.scopeStack.size() > 1) {
+        state.exitScope();
+    }
+    state.functionStack.clear();
+    state.undoRegistrations();
+    state.startModule(nextModule);
+}
+
+int runRepl(const ModuleConfig& config) {
+    auto jit = AxonJIT::create(config);
+    if (!jit) {
+        return 1;
+    }
+    ModuleState state(config);
+    // Identifiers keep pointing at the declarations of the module they were defined in, so finished modules have to
+    // stay around for later entries to redeclare them
+    std::vector<std::unique_ptr<Module> > finishedModules;
+
+    for (size_t entryIndex = 0; ; entryIndex++) {
+        auto text = readStdin();
+        if (!text.has_value()) {
+            break;
+        }
+
+        Lexer lexer(text.value());
+        auto entry = parseEntry(lexer);
+        if (!entry) {
+            logError(lexer.formatParsingError(REPL_UNIT, REPL_FILE));
+            continue;
+        }
+        if (entry->definitions.empty() && entry->statements.empty()) {
+            continue;
+        }
+
+        auto nextModule = REPL_UNIT + std::to_string(entryIndex + 1);
+        auto entryFunction = "$entry" + std::to_string(entryIndex);
+        auto hasStatements = !entry->statements.empty();
+        state.recordRegistrations();
+        if (!compileEntry(state, lexer, *entry, entryFunction) || !jit->addIncrementalModule(*state.module)) {
+            discardEntry(state, nextModule);
+            continue;
+        }
+        state.keepRegistrations();
+        finishedModules.push_back(state.startModule(nextModule));
+
+        if (hasStatements) {
+            jit->runFunction(REPL_UNIT + "." + entryFunction);
+        }
+    }
+    std::cout << std::endl;
+    return 0;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+class ModuleConfig;
+
+/// Interactive session on top of the JIT.
+/// Every entry is compiled into its own module against the identifiers of all previous entries, so nothing is ever
+/// recompiled. Definitions (functions, structs, imports) are registered as if they were in a unit, while all other
+/// statements are wrapped in a function that runs as soon as the entry is compiled.
+/// Returns the process exit code.
+int runRepl(const ModuleConfig& config);
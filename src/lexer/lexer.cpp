@@ -4,6 +4,24 @@
 #include "logging.h"
 #include "ast/ast.h"
 
+std::optional<std::pair<std::string, unsigned> > vectorTypeParts(const std::string& name) {
+    auto separator = name.rfind('x');
+    auto isDigit = [](const unsigned char c) { return isdigit(c); };
+    if (separator == std::string::npos || separator == 0 || separator + 1 == name.length() ||
+        !std::all_of(name.begin() + separator + 1, name.end(), isDigit) || name.length() - separator > 3) {
+        return std::nullopt;
+    }
+    auto element = name.substr(0, separator);
+    if (!TYPES.contains(element) || element == KW_VOID) {
+        return std::nullopt;
+    }
+    unsigned lanes = std::stoul(name.substr(separator + 1));
+    if (lanes < 2 || lanes > MAX_VECTOR_LANES || (lanes & (lanes - 1)) != 0) {
+        return std::nullopt;
+    }
+    return std::make_pair(element, lanes);
+}
+
 char Lexer::next() {
     index += 1;
     if (index >= text.length()) {
@@ -34,6 +52,22 @@ Token Lexer::consume() {
     return curToken;
 }
 
+size_t Lexer::tokenCount() const {
+    return tokens.size();
+}
+
+size_t Lexer::tokenBytes() const {
+    // Short tokens live inside the string itself (small string optimization)
+    static const size_t inlineCapacity = std::string().capacity();
+    size_t bytes = text.capacity() + tokens.capacity() * sizeof(Token);
+    for (const auto& token: tokens) {
+        if (token.rawToken.capacity() > inlineCapacity) {
+            bytes += token.rawToken.capacity() + 1;
+        }
+    }
+    return bytes;
+}
+
 Token Lexer::peek(int num) {
     while (tokenIndex + num < tokens.size() && tokens[tokenIndex + num].type == TOK_WHITESPACE) {
         num += 1;
@@ -78,7 +112,7 @@ Token Lexer::process() {
             next();
         }
         TokenType type;
-        if (TYPES.contains(rawToken)) {
+        if (TYPES.contains(rawToken) || vectorTypeParts(rawToken)) {
             type = TOK_TYPE;
         } else if (VALUES.contains(rawToken)) {
             type = TOK_VALUE;
@@ -122,20 +156,21 @@ Token Lexer::process() {
     }
 
     // operators
-    for (const auto& op: ALLOPS) {
-        auto length = op.length();
+    for (const auto op: LEXED_OPERATORS) {
+        auto str = OPERATOR_STRINGS[op];
+        auto length = str.length();
         if (index + length > text.length()) {
             continue;
         }
-        if (text.substr(index, length) == op) {
+        if (text.compare(index, length, str) == 0) {
             index += length - 1;
             next();
-            auto type = BINOPS.contains(op)
+            auto type = isBinop(op)
                             ? TOK_BINOP
-                            : UNOPS.contains(op)
-                                  ? TOK_UNOP
-                                  : TOK_VAROP;
-            return Token(op, type);
+                            : isVarop(op)
+                                  ? TOK_VAROP
+                                  : TOK_UNOP;
+            return Token(std::string(str), type, op);
         }
     }
 
@@ -176,6 +211,32 @@ DebugInfo Lexer::popDebugInfo(const bool remove) {
     return DebugInfo(debugStatementStart, startToken, tokenIndex);
 }
 
+int Lexer::debugPosition() const {
+    return tokenIndex;
+}
+
+DebugInfo Lexer::debugInfoFrom(const int startToken) const {
+    return DebugInfo(debugStatementStart, startToken, tokenIndex);
+}
+
+std::pair<int, int> Lexer::tokenLocation(const int token) {
+    if (tokenLocations.empty()) {
+        int line = 1;
+        int column = 1;
+        tokenLocations.reserve(tokens.size());
+        for (const auto& cur: tokens) {
+            tokenLocations.emplace_back(line, column);
+            if (cur.rawToken == "\n") {
+                line += 1;
+                column = 1;
+            } else {
+                column += cur.rawToken.length();
+            }
+        }
+    }
+    return tokenLocations[std::clamp<int>(token, 0, tokenLocations.size() - 1)];
+}
+
 std::nullptr_t Lexer::expected(const std::string& expected) {
     parsingError = "Expected " + expected + ", got " + (curToken.rawToken == "\n" ? "\\n" : curToken.rawToken);
     return nullptr;
@@ -195,16 +256,7 @@ std::string Lexer::formatError(const DebugInfo& debugInfo,
                                const std::string& unit,
                                const std::string& filename,
                                const std::string& error) {
-    int line = 1;
-    int column = 1;
-    for (int i = 0; i < debugInfo.startToken; i++) {
-        if (tokens[i].rawToken == "\n") {
-            line += 1;
-            column = 1;
-        } else {
-            column += tokens[i].rawToken.length();
-        }
-    }
+    auto [line, column] = tokenLocation(debugInfo.startToken);
 
     auto prefix = "    > ";
     std::string highlighted = "";
@@ -6,9 +6,12 @@
 #include <unordered_set>
 #include <utility>
 #include <iostream>
+#include <optional>
 #include <ranges>
 #include <vector>
 
+#include "operators.h"
+
 struct DebugInfo;
 
 enum TokenType {
@@ -25,56 +28,6 @@ enum TokenType {
     TOK_UNKNOWN,
 };
 
-inline const std::unordered_map<std::string, int> BINOPS{
-    {"*", 100},
-    {"/", 100},
-    {"%", 100},
-
-    {"+", 90},
-    {"-", 90},
-
-    {"<<", 80},
-    {">>", 80},
-
-    {"<", 70},
-    {">", 70},
-    {"<=", 70},
-    {">=", 70},
-
-    {"==", 60},
-    {"!=", 60},
-
-    {"&", 50},
-
-    {"^", 40},
-
-    {"|", 30},
-
-    {"&&", 20},
-
-    {"||", 10}
-};
-
-inline const std::unordered_set<std::string> UNOPS{
-    "~",
-    "-",
-    "!",
-};
-
-inline const std::unordered_set<std::string> VAROPS{
-    "=",
-    "+=",
-    "-=",
-    "*=",
-    "/=",
-    "%=",
-    "|=",
-    "&=",
-    "^=",
-    "<<=",
-    ">>="
-};
-
 inline const std::unordered_map<char, std::string> ESCAPES{
     {'"', "\""},
     {'\'', "'"},
@@ -82,23 +35,21 @@ inline const std::unordered_map<char, std::string> ESCAPES{
     {'n', "\n"},
 };
 
-inline const std::vector<std::string> ALLOPS = []() {
-    std::vector<std::string> allOps;
-    allOps.reserve(BINOPS.size() + UNOPS.size() + VAROPS.size());
-    for (const auto& str: BINOPS | std::views::keys) {
-        allOps.push_back(str);
+// Every operator the lexer matches, longest first so i.e. <<= isn't lexed as << followed by =
+inline const std::vector<OperatorKind> LEXED_OPERATORS = []() {
+    std::vector<OperatorKind> ops;
+    ops.reserve(OPERATOR_COUNT);
+    for (size_t op = 0; op < OPERATOR_COUNT; op++) {
+        // Negation is spelled like subtraction; the parser tells them apart
+        if (op != OP_NEG) {
+            ops.push_back(static_cast<OperatorKind>(op));
+        }
     }
-    for (const auto& str: UNOPS) {
-        allOps.push_back(str);
-    }
-    for (const auto& str: VAROPS) {
-        allOps.push_back(str);
-    }
-    std::ranges::sort(allOps,
-                      [](const std::string& a, const std::string& b) {
-                          return a.length() > b.length();
-                      });
-    return allOps;
+    std::ranges::stable_sort(ops,
+                             [](const OperatorKind a, const OperatorKind b) {
+                                 return OPERATOR_STRINGS[a].length() > OPERATOR_STRINGS[b].length();
+                             });
+    return ops;
 }();
 
 // TODO: figure out if we need ptr types (only very rarely different from size anyways)
@@ -145,11 +96,14 @@ inline const std::unordered_set<std::string> VALUES{
     KEYWORD(WHILE, "while") \
     KEYWORD(RETURN, "return") \
     KEYWORD(EXTERN, "extern") \
+    KEYWORD(EXPORT, "export") \
     KEYWORD(STRUCT, "struct") \
+    KEYWORD(INLINE, "inline") \
     KEYWORD(LET, "let") \
     KEYWORD(FROM, "from") \
     KEYWORD(IMPORT, "import") \
-    KEYWORD(AS, "as")
+    KEYWORD(AS, "as") \
+    KEYWORD(BUILTIN, "builtin")
 
 #define KEYWORD(NAME, STR) const std::string KW_##NAME = STR;
 X_KW
@@ -161,6 +115,12 @@ X_TYPE
 X_VALUE
 #undef VALUE
 
+// Vector types are spelled <element>x<lanes>, i.e. floatx4 or bytex16. Elements are number, floating point or bool
+// types, and lanes a power of two up to MAX_VECTOR_LANES. Returns the element type and lanes if the name is one.
+inline constexpr unsigned MAX_VECTOR_LANES = 64;
+
+std::optional<std::pair<std::string, unsigned> > vectorTypeParts(const std::string& name);
+
 inline const std::unordered_set<std::string> KEYWORDS{
 #define KEYWORD(NAME, STR) STR,
     X_KW
@@ -177,8 +137,11 @@ struct Token {
     std::string rawToken;
     // TODO: multiple types (since identifier can be a type as well, minus can be unary and binary op, etc.)
     TokenType type;
+    // Set for TOK_BINOP, TOK_UNOP and TOK_VAROP
+    OperatorKind op = OP_NONE;
 
-    explicit Token(std::string rawToken, const TokenType type): rawToken(std::move(rawToken)), type(type) {
+    explicit Token(std::string rawToken, const TokenType type, const OperatorKind op = OP_NONE):
+        rawToken(std::move(rawToken)), type(type), op(op) {
     }
 
     explicit Token(): rawToken(std::string(1, EOF)), type(TOK_EOF) {
@@ -202,6 +165,8 @@ class Lexer {
 
     int debugStatementStart;
     std::vector<int> debugTokenStack;
+    // Line and column of every token, computed on first use
+    std::vector<std::pair<int, int> > tokenLocations;
 
 public:
     std::string parsingError;
@@ -223,6 +188,11 @@ public:
 
     Token consume();
 
+    size_t tokenCount() const;
+
+    // Estimate of the heap memory held by this lexer's source text and tokens
+    size_t tokenBytes() const;
+
     Token peek(int num);
 
     void startDebugStatement();
@@ -231,6 +201,14 @@ public:
 
     DebugInfo popDebugInfo(bool remove = true);
 
+    // For nodes that track where they started themselves instead of going through the debug info stack
+    int debugPosition() const;
+
+    DebugInfo debugInfoFrom(int startToken) const;
+
+    // 1-based line and column where a token starts
+    std::pair<int, int> tokenLocation(int token);
+
     std::nullptr_t expected(const std::string& expected);
 
     std::string formatParsingError(const std::string& unit,
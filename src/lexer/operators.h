@@ -0,0 +1,113 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+// Operators are resolved once by the lexer; everything after it works with the enum and the tables below
+
+// binary operators, with their precedence (higher binds tighter)
+#define X_BINOP \
+    BINOP(MUL, "*", 100) \
+    BINOP(DIV, "/", 100) \
+    BINOP(REM, "%", 100) \
+    BINOP(ADD, "+", 90) \
+    BINOP(SUB, "-", 90) \
+    BINOP(SHL, "<<", 80) \
+    BINOP(SHR, ">>", 80) \
+    BINOP(LT, "<", 70) \
+    BINOP(GT, ">", 70) \
+    BINOP(LE, "<=", 70) \
+    BINOP(GE, ">=", 70) \
+    BINOP(EQ, "==", 60) \
+    BINOP(NE, "!=", 60) \
+    BINOP(BIT_AND, "&", 50) \
+    BINOP(BIT_XOR, "^", 40) \
+    BINOP(BIT_OR, "|", 30) \
+    BINOP(AND, "&&", 20) \
+    BINOP(OR, "||", 10)
+
+// unary operators; - is always lexed as OP_SUB, and the parser turns it into OP_NEG in front of an operand
+#define X_UNOP \
+    UNOP(BIT_NOT, "~") \
+    UNOP(NEG, "-") \
+    UNOP(NOT, "!")
+
+// variable assignment operators, with the binary operator a compound assignment applies
+#define X_VAROP \
+    VAROP(ASSIGN, "=", NONE) \
+    VAROP(ADD_ASSIGN, "+=", ADD) \
+    VAROP(SUB_ASSIGN, "-=", SUB) \
+    VAROP(MUL_ASSIGN, "*=", MUL) \
+    VAROP(DIV_ASSIGN, "/=", DIV) \
+    VAROP(REM_ASSIGN, "%=", REM) \
+    VAROP(BIT_OR_ASSIGN, "|=", BIT_OR) \
+    VAROP(BIT_AND_ASSIGN, "&=", BIT_AND) \
+    VAROP(BIT_XOR_ASSIGN, "^=", BIT_XOR) \
+    VAROP(SHL_ASSIGN, "<<=", SHL) \
+    VAROP(SHR_ASSIGN, ">>=", SHR)
+
+enum OperatorKind : uint8_t {
+#define BINOP(NAME, STR, PRECEDENCE) OP_##NAME,
+    X_BINOP
+#undef BINOP
+#define UNOP(NAME, STR) OP_##NAME,
+    X_UNOP
+#undef UNOP
+#define VAROP(NAME, STR, BINOP) OP_##NAME,
+    X_VAROP
+#undef VAROP
+    OP_NONE,
+};
+
+inline constexpr size_t OPERATOR_COUNT = OP_NONE;
+
+inline constexpr std::array<std::string_view, OPERATOR_COUNT> OPERATOR_STRINGS{
+#define BINOP(NAME, STR, PRECEDENCE) STR,
+    X_BINOP
+#undef BINOP
+#define UNOP(NAME, STR) STR,
+    X_UNOP
+#undef UNOP
+#define VAROP(NAME, STR, BINOP) STR,
+    X_VAROP
+#undef VAROP
+};
+
+// 0 for anything that isn't a binary operator
+inline constexpr std::array<int, OPERATOR_COUNT> OPERATOR_PRECEDENCE{
+#define BINOP(NAME, STR, PRECEDENCE) PRECEDENCE,
+    X_BINOP
+#undef BINOP
+#define UNOP(NAME, STR) 0,
+    X_UNOP
+#undef UNOP
+#define VAROP(NAME, STR, BINOP) 0,
+    X_VAROP
+#undef VAROP
+};
+
+// The binary operator applied by a compound assignment; OP_NONE for everything else
+inline constexpr std::array<OperatorKind, OPERATOR_COUNT> COMPOUND_BINOPS{
+#define BINOP(NAME, STR, PRECEDENCE) OP_NONE,
+    X_BINOP
+#undef BINOP
+#define UNOP(NAME, STR) OP_NONE,
+    X_UNOP
+#undef UNOP
+#define VAROP(NAME, STR, BINOP) OP_##BINOP,
+    X_VAROP
+#undef VAROP
+};
+
+constexpr bool isBinop(const OperatorKind op) {
+    return op < OPERATOR_COUNT && OPERATOR_PRECEDENCE[op] > 0;
+}
+
+constexpr bool isVarop(const OperatorKind op) {
+    return op >= OP_ASSIGN && op < OP_NONE;
+}
+
+constexpr std::string_view operatorString(const OperatorKind op) {
+    return op < OPERATOR_COUNT ? OPERATOR_STRINGS[op] : "";
+}
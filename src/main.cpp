@@ -1,3 +1,5 @@
+#include <chrono>
+#include <format>
 #include <fstream>
 #include <iostream>
 
@@ -5,21 +7,167 @@
 #include "module/generated.h"
 #include "module/module_state.h"
 #include "module/module_config.h"
+#include "memory.h"
+#include "timing.h"
+#include "jit/jit.h"
+#include "jit/repl.h"
+#include "daemon/daemon.h"
+#include "watch/watcher.h"
+#include "logging.h"
+
+std::optional<int> runModule(ModuleState& module) {
+    auto jit = AxonJIT::create(module.config);
+    if (!jit || !jit->addModule(module)) {
+        return std::nullopt;
+    }
+    auto exitCode = jit->runMain();
+    if (module.config.timeReport) {
+        std::cerr << "JIT materialized " << jit->materializedFunctions() << " of " << jit->totalFunctions()
+                << " functions" << std::endl;
+    }
+    return exitCode;
+}
 
 void cleanup() {
     // This makes it easier to find leaks
     GeneratedType::free();
 }
 
-int main(const int argc, char* argv[]) {
+// Whether the build file itself is among the changed paths
+static bool buildFileChanged(const ModuleConfig& config, const std::vector<std::filesystem::path>& changed) {
+    std::error_code ec;
+    auto buildFile = std::filesystem::weakly_canonical(config.buildFile, ec);
+    return std::ranges::any_of(changed, [&](const auto& path) {
+        return path.extension() == ".toml" && std::filesystem::weakly_canonical(path, ec) == buildFile;
+    });
+}
+
+int watchModule(ModuleConfig config) {
+    FileWatcher watcher;
+    if (!watcher.valid()) {
+        return 1;
+    }
+    // Unchanged units are neither reparsed nor codegenned again
+    ModuleState::enableUnitCache();
+
+    while (true) {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::filesystem::path> unitPaths;
+        size_t recompiled;
+        size_t total;
+        bool success;
+        {
+            ModuleState module(config);
+            success = module.compileModule() && module.optimize() && module.writeIR();
+            unitPaths = module.unitPaths();
+            recompiled = module.recompiledUnitCount();
+            total = module.unitCount();
+        }
+        auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (success) {
+            std::cerr << std::format("Build successful ({} of {} units recompiled, {:.1f} ms).",
+                                     recompiled,
+                                     total,
+                                     elapsed) << std::endl;
+        } else {
+            std::cerr << "Build error." << std::endl;
+        }
+
+        // Units can be added or moved by any change, so the set of watched directories is refreshed every build
+        watcher.watchDirectory(config.moduleRoot());
+        for (const auto& path: unitPaths) {
+            watcher.watchDirectory(path.parent_path());
+        }
+        while (true) {
+            auto changed = watcher.waitForChanges();
+            std::cerr << "Changed " << changed.front().string()
+                    << (changed.size() > 1 ? " and " + std::to_string(changed.size() - 1) + " more" : "")
+                    << ", rebuilding" << std::endl;
+            if (!buildFileChanged(config, changed)) {
+                break;
+            }
+            // The module name and main come from the build file, so the rebuild has to use the new ones
+            auto reloaded = config;
+            if (reloaded.parseConfig()) {
+                config = std::move(reloaded);
+                break;
+            }
+            std::cerr << "Build error." << std::endl;
+        }
+    }
+}
+
+int build(const int argc, char* argv[]) {
     ModuleConfig config;
     if (!config.parseArgs(argc, argv) || !config.parseConfig()) {
         return 1;
     }
 
+    PhaseTimer::enable(config.timeReport, config.timeTrace.has_value());
+
+    if (config.mode == MODE_REPL) {
+        return runRepl(config);
+    }
+    if (config.watch) {
+        return watchModule(config);
+    }
+
     ModuleState module(config);
-    bool success = module.compileModule() && module.writeIR();
-    std::cerr << (success ? "Build successful." : "Build error.") << std::endl;
+    bool success = module.compileModule();
+    // The lazy JIT optimizes each function as it gets compiled instead
+    if (success && !(config.mode == MODE_RUN && config.lazyJIT)) {
+        success = module.optimize();
+    }
+    int exitCode = success ? 0 : 1;
+    if (config.mode == MODE_RUN) {
+        // Stay quiet on success so the program's own output is all that's printed
+        if (success) {
+            auto result = runModule(module);
+            success = result.has_value();
+            exitCode = result.value_or(1);
+        } else {
+            std::cerr << "Build error." << std::endl;
+        }
+    } else {
+        success = success && module.writeIR();
+        exitCode = success ? 0 : 1;
+        std::cerr << (success ? "Build successful." : "Build error.") << std::endl;
+    }
+
+    if (config.timeReport) {
+        PhaseTimer::printReport(std::cerr);
+    }
+    if (config.timeTrace.has_value()) {
+        PhaseTimer::writeTrace(config.timeTrace.value());
+    }
+    if (config.memReport) {
+        module.printMemReport(std::cerr);
+    }
+    return exitCode;
+}
+
+int main(const int argc, char* argv[]) {
+    auto command = argc > 1 ? std::string(argv[1]) : "";
+    // AXON_DAEMON is the socket to use; set but empty means the default socket
+    auto* daemonEnv = std::getenv("AXON_DAEMON");
+    auto socketPath = daemonEnv && *daemonEnv ? std::filesystem::path(daemonEnv) : defaultDaemonSocket();
+    if (command == "daemon") {
+        ModuleState::enableUnitCache();
+        return runDaemon(argc > 2 ? std::filesystem::path(argv[2]) : socketPath, build);
+    }
+
+    // Run and repl execute the program itself, which shouldn't happen inside the daemon, and watch never finishes
+    auto watching = std::ranges::any_of(argv,
+                                        argv + argc,
+                                        [](const char* arg) { return std::string(arg) == "--watch"; });
+    if (daemonEnv && command != "run" && command != "repl" && !watching) {
+        if (auto exitCode = runDaemonClient(socketPath, argc, argv)) {
+            return exitCode.value();
+        }
+        logWarning("No daemon listening on " + socketPath.string() + ", building in process");
+    }
+
+    auto exitCode = build(argc, argv);
     cleanup();
-    return success ? 0 : 1;
+    return exitCode;
 }
@@ -0,0 +1,17 @@
+#include <sys/resource.h>
+
+#include "memory.h"
+
+size_t peakRSS() {
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    // macOS reports bytes...
+    return usage.ru_maxrss;
+#else
+    // ...while linux reports kilobytes
+    return usage.ru_maxrss * 1024;
+#endif
+}
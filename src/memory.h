@@ -0,0 +1,6 @@
+#pragma once
+
+#include <cstddef>
+
+// Peak resident set size of the compiler process in bytes, or 0 if it can't be determined
+size_t peakRSS();
@@ -1,3 +1,5 @@
+#include <mutex>
+
 #include <llvm/IR/DerivedTypes.h>
 
 #include "generated.h"
@@ -12,12 +14,13 @@ bool TypeBacker::operator==(const TypeBacker& other) const {
 }
 
 size_t std::hash<TypeBacker>::operator()(const TypeBacker& type) const noexcept {
-    size_t seed = std::hash<std::variant<std::string, GeneratedType*, FunctionTypeBacker> >()(type.backer);
+    using Backer = std::variant<std::string, GeneratedType*, FunctionTypeBacker, VectorTypeBacker>;
+    size_t seed = std::hash<Backer>()(type.backer);
     seed = combineHash(seed, std::hash<bool>()(type.owned));
     return seed;
 }
 
-std::unordered_map<TypeBacker, GeneratedType*> GeneratedType::registeredTypes{};
+std::array<TypeShard, GeneratedType::TYPE_SHARDS> GeneratedType::registeredTypes{};
 
 GeneratedType* GeneratedType::rawGet(std::string rawType) {
     bool owned;
@@ -28,9 +31,11 @@ GeneratedType* GeneratedType::rawGet(std::string rawType) {
         owned = false;
     }
 
-    std::variant<std::string, GeneratedType*, FunctionTypeBacker> backer;
+    std::variant<std::string, GeneratedType*, FunctionTypeBacker, VectorTypeBacker> backer;
     if (rawType.ends_with("[]")) {
         backer = rawGet(rawType.substr(0, rawType.length() - 2));
+    } else if (auto vector = vectorTypeParts(rawType)) {
+        backer = VectorTypeBacker(rawGet(vector->first), vector->second);
     } else {
         backer = rawType;
     }
@@ -38,19 +43,43 @@ GeneratedType* GeneratedType::rawGet(std::string rawType) {
 }
 
 GeneratedType* GeneratedType::get(const TypeBacker& type) {
-    if (!registeredTypes.contains(type)) {
-        auto* generatedType = new GeneratedType(type);
-        registeredTypes.insert_or_assign(type, generatedType);
+    auto& shard = registeredTypes[std::hash<TypeBacker>()(type) % TYPE_SHARDS];
+    {
+        // Fast path; almost every lookup is for a type that already exists
+        std::shared_lock lock(shard.mutex);
+        if (auto it = shard.types.find(type); it != shard.types.end()) {
+            return it->second;
+        }
+    }
+
+    // Another thread may have inserted the type between the two locks, so only create it if it's still missing
+    std::unique_lock lock(shard.mutex);
+    auto [it, inserted] = shard.types.try_emplace(type, nullptr);
+    if (inserted) {
+        it->second = new GeneratedType(type);
     }
-    return registeredTypes.at(type);
+    return it->second;
 }
 
 void GeneratedType::free() {
-    for (auto type: registeredTypes | std::views::values) {
-        delete type;
+    for (auto& shard: registeredTypes) {
+        std::unique_lock lock(shard.mutex);
+        for (auto type: shard.types | std::views::values) {
+            delete type;
+        }
+        shard.types.clear();
     }
 }
 
+size_t GeneratedType::registeredCount() {
+    size_t count = 0;
+    for (auto& shard: registeredTypes) {
+        std::shared_lock lock(shard.mutex);
+        count += shard.types.size();
+    }
+    return count;
+}
+
 bool GeneratedType::isBase() {
     return std::holds_alternative<std::string>(type.backer);
 }
@@ -104,6 +133,10 @@ bool GeneratedType::isArray() {
     return std::holds_alternative<GeneratedType*>(type.backer);
 }
 
+bool GeneratedType::isOwned() {
+    return type.owned;
+}
+
 GeneratedType* GeneratedType::getArrayBase() {
     return isArray() ? std::get<GeneratedType*>(type.backer) : nullptr;
 }
@@ -112,6 +145,26 @@ GeneratedType* GeneratedType::getArrayType(const bool owned) {
     return get(TypeBacker(this, owned));
 }
 
+bool GeneratedType::isVector() {
+    return std::holds_alternative<VectorTypeBacker>(type.backer);
+}
+
+GeneratedType* GeneratedType::getVectorElement() {
+    return isVector() ? std::get<0>(std::get<VectorTypeBacker>(type.backer)) : nullptr;
+}
+
+unsigned GeneratedType::getVectorLanes() {
+    return isVector() ? std::get<1>(std::get<VectorTypeBacker>(type.backer)) : 0;
+}
+
+GeneratedType* GeneratedType::getVectorType(const unsigned lanes) {
+    return get(TypeBacker(VectorTypeBacker(this, lanes), false));
+}
+
+GeneratedType* GeneratedType::getScalarType() {
+    return isVector() ? getVectorElement() : this;
+}
+
 bool GeneratedType::isFunction() {
     return std::holds_alternative<FunctionTypeBacker>(type.backer);
 }
@@ -130,6 +183,8 @@ GeneratedType* GeneratedType::getReturnType() {
 bool GeneratedType::isDefined(ModuleState& state) {
     if (isArray()) {
         return getArrayBase()->isDefined(state);
+    } else if (isVector()) {
+        return true;
     } else if (isFunction()) {
         for (const auto& arg: getArgs()) {
             if (!arg->isDefined(state)) {
@@ -157,6 +212,8 @@ Type* GeneratedType::getLLVMType(const ModuleState& state) {
             argTypes.push_back(arg->getLLVMType(state));
         }
         return FunctionType::get(getReturnType()->getLLVMType(state), argTypes, false);
+    } else if (isVector()) {
+        return FixedVectorType::get(getVectorElement()->getLLVMType(state), getVectorLanes());
     }
 
     assert(isBase());
@@ -180,11 +237,11 @@ Type* GeneratedType::getLLVMType(const ModuleState& state) {
     } else if (TYPES.contains(ty)) {
         logError("type " + ty + " not implemented yet");
         assert(false);
+    } else if (auto* inlineStruct = state.getInlineStructType(ty)) {
+        return inlineStruct;
     } else {
         // Checking if the struct actually exists here would be a massive PITA
         // for such marginally low value, so we just assume it's a pointer.
-        // Figuring out structs without pointers is going to be piss awful given
-        // we can't allow recursive types.
         return PointerType::getUnqual(*state.ctx);
     }
 }
@@ -196,7 +253,10 @@ std::unique_ptr<GeneratedValue> GeneratedValue::getFieldPointer(ModuleState& sta
     }
 
     if (genStruct->methods.contains(fieldName)) {
-        return std::make_unique<GeneratedValue>(*genStruct->methods.at(fieldName));
+        auto method = std::make_unique<GeneratedValue>(*genStruct->methods.at(fieldName));
+        state.requireBody(method->value);
+        method->value = state.importGlobal(method->value);
+        return method;
     }
 
     auto fieldIndex = genStruct->getFieldIndex(fieldName);
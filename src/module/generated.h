@@ -1,6 +1,8 @@
 #pragma once
 
+#include <array>
 #include <cassert>
+#include <shared_mutex>
 #include <string>
 #include <unordered_map>
 
@@ -22,11 +24,11 @@ class ModuleState;
 struct SigArg;
 
 struct TypeBacker {
-    std::variant<std::string, GeneratedType*, FunctionTypeBacker> backer;
+    std::variant<std::string, GeneratedType*, FunctionTypeBacker, VectorTypeBacker> backer;
     bool owned;
     // TODO: add optional
 
-    explicit TypeBacker(const std::variant<std::string, GeneratedType*, FunctionTypeBacker>& backer,
+    explicit TypeBacker(const std::variant<std::string, GeneratedType*, FunctionTypeBacker, VectorTypeBacker>& backer,
                         const bool owned): backer(backer), owned(owned) {
     }
 
@@ -38,13 +40,23 @@ struct std::hash<TypeBacker> {
     size_t operator()(const TypeBacker& type) const noexcept;
 };
 
+/// One shard of the type interning table. Each shard is guarded by its own lock so threads interning
+/// unrelated types don't contend with each other.
+struct TypeShard {
+    std::shared_mutex mutex;
+    std::unordered_map<TypeBacker, GeneratedType*> types;
+};
+
 /// Similar to LLVM, types are pointers to singletons that aren't freed until program end (flyweights).
 /// Every individual type is a pointer to the same object.
 /// Note: types are identified solely by the identifier used in their unit, so types between units
 /// are not guaranteed equal.
+/// Interning is thread safe; since types are never moved or freed before program end, pointers stay stable
+/// and can be compared by identity across threads.
 struct GeneratedType {
 private:
-    static std::unordered_map<TypeBacker, GeneratedType*> registeredTypes;
+    static constexpr size_t TYPE_SHARDS = 32;
+    static std::array<TypeShard, TYPE_SHARDS> registeredTypes;
 
     TypeBacker type;
 
@@ -58,6 +70,8 @@ public:
 
     static void free();
 
+    static size_t registeredCount();
+
     std::string toString();
 
     bool isBase();
@@ -76,10 +90,23 @@ public:
 
     bool isArray();
 
+    bool isOwned();
+
     GeneratedType* getArrayBase();
 
     GeneratedType* getArrayType(bool owned);
 
+    bool isVector();
+
+    GeneratedType* getVectorElement();
+
+    unsigned getVectorLanes();
+
+    GeneratedType* getVectorType(unsigned lanes);
+
+    // The element type for vectors, since operators work on them lane by lane; the type itself otherwise
+    GeneratedType* getScalarType();
+
     bool isFunction();
 
     std::vector<GeneratedType*> getArgs();
@@ -113,12 +140,16 @@ struct GeneratedStruct {
     std::vector<std::tuple<std::string, GeneratedType*> > fields;
     std::unordered_map<std::string, std::shared_ptr<GeneratedValue> > methods;
     StructType* structType;
+    // Values of inline structs are the struct itself rather than a pointer to it
+    bool isInline;
 
     explicit GeneratedStruct(GeneratedType* type,
                              std::vector<std::tuple<std::string, GeneratedType*> > fields,
                              std::unordered_map<std::string, std::shared_ptr<GeneratedValue> > methods,
-                             StructType* structType
-    ): type(type), fields(std::move(fields)), methods(std::move(methods)), structType(structType) {
+                             StructType* structType,
+                             const bool isInline
+    ): type(type), fields(std::move(fields)), methods(std::move(methods)), structType(structType),
+       isInline(isInline) {
     }
 
     std::optional<int> getFieldIndex(const std::string& fieldName);
@@ -4,11 +4,35 @@
 #include "module_config.h"
 
 bool ModuleConfig::parseArgs(int argc, char* argv[]) {
+    // Modes are handled before argparse since the optional build file positional would swallow them
+    mode = MODE_BUILD;
+    if (argc > 1 && (std::string(argv[1]) == "run" || std::string(argv[1]) == "repl")) {
+        mode = std::string(argv[1]) == "run" ? MODE_RUN : MODE_REPL;
+        argv[1] = argv[0];
+        argc -= 1;
+        argv += 1;
+    }
+
     argparse::ArgumentParser program("Axon");
+    program.add_epilog("Use `Axon run [build-file]` to compile and run main in process instead of writing a file, or "
+        "`Axon repl [build-file]` to enter code interactively.");
     program.add_argument("build-file").default_value(".").help("the build file");
 
     program.add_argument("--output-file", "-o").help("the output file or - to output to stdout");
     program.add_argument("--output-ll", "-l").help("output human readable ir instead of bitcode").flag();
+    program.add_argument("--opt-level", "-O").help("optimization level (0-3)").default_value(0).scan<'i', int>();
+    program.add_argument("--lazy").help("in run mode, compile each function on its first call").flag();
+    program.add_argument("--watch").help("rebuild incrementally whenever a unit changes").flag();
+    program.add_argument("-g").help("emit debug info for debuggers and profilers").flag();
+    program.add_argument("--instrument-functions").help("call tracing hooks on every function entry and exit").flag();
+    program.add_argument("--coverage").help("count how often each block runs, for coverage reports").flag();
+    program.add_argument("--alloc-profile").help("count allocations and bytes per allocation site").flag();
+    program.add_argument("--profile-generate").help("instrument the program to write an execution profile").flag();
+    program.add_argument("--profile-use").help("optimize using a profile merged with llvm-profdata");
+
+    program.add_argument("--time-report").help("print time spent in each compiler phase").flag();
+    program.add_argument("--time-trace").help("write a chrome trace_event json file of compiler phases");
+    program.add_argument("--mem-report").help("print peak memory use and a breakdown of compiler data").flag();
 
     try {
         program.parse_args(argc, argv);
@@ -20,6 +44,71 @@ bool ModuleConfig::parseArgs(int argc, char* argv[]) {
 
     buildFile = program.get("build-file");
     outputLL = program.get<bool>("--output-ll");
+    optLevel = program.get<int>("--opt-level");
+    if (optLevel < 0 || optLevel > 3) {
+        std::cout << "Optimization level must be between 0 and 3" << std::endl;
+        return false;
+    }
+
+    lazyJIT = program.get<bool>("--lazy");
+    if (lazyJIT && mode != MODE_RUN) {
+        std::cout << "--lazy can only be used in run mode" << std::endl;
+        return false;
+    }
+    watch = program.get<bool>("--watch");
+    if (watch && mode != MODE_BUILD) {
+        std::cout << "--watch can only be used when building" << std::endl;
+        return false;
+    }
+    debugInfo = program.get<bool>("-g");
+    // Debug info is built for a single module at a time
+    if (debugInfo && (watch || mode == MODE_REPL)) {
+        std::cout << "-g can't be used with --watch or the repl" << std::endl;
+        return false;
+    }
+    instrumentFunctions = program.get<bool>("--instrument-functions");
+    // The hooks come from a runtime linked into the program, and the function table has to cover the whole program
+    if (instrumentFunctions && (watch || mode != MODE_BUILD)) {
+        std::cout << "--instrument-functions can only be used for regular builds" << std::endl;
+        return false;
+    }
+    coverage = program.get<bool>("--coverage");
+    if (coverage && (watch || mode != MODE_BUILD)) {
+        std::cout << "--coverage can only be used for regular builds" << std::endl;
+        return false;
+    }
+    allocProfile = program.get<bool>("--alloc-profile");
+    if (allocProfile && (watch || mode != MODE_BUILD)) {
+        std::cout << "--alloc-profile can only be used for regular builds" << std::endl;
+        return false;
+    }
+    profileGenerate = program.get<bool>("--profile-generate");
+    if (profileGenerate && mode != MODE_BUILD) {
+        std::cout << "--profile-generate can only be used when building" << std::endl;
+        return false;
+    }
+    if (auto file = program.present("--profile-use")) {
+        profileUse = *file;
+        if (profileGenerate) {
+            std::cout << "--profile-generate and --profile-use can't be used together" << std::endl;
+            return false;
+        }
+        // The -O0 pipeline runs none of the passes that read the profile
+        if (optLevel == 0) {
+            std::cout << "--profile-use requires an optimization level above 0" << std::endl;
+            return false;
+        }
+        if (!is_regular_file(*profileUse)) {
+            std::cout << "Profile " << profileUse->string() << " does not exist" << std::endl;
+            return false;
+        }
+    }
+
+    timeReport = program.get<bool>("--time-report");
+    if (auto file = program.present("--time-trace")) {
+        timeTrace = *file;
+    }
+    memReport = program.get<bool>("--mem-report");
     if (auto file = program.present("output-file")) {
         outputFile = *file;
     } else {
@@ -35,6 +124,14 @@ bool ModuleConfig::parseArgs(int argc, char* argv[]) {
 }
 
 bool ModuleConfig::parseConfig() {
+    // The repl doesn't need a module; without one, imports resolve relative to the working directory
+    if (mode == MODE_REPL && !is_regular_file(buildFile)) {
+        name = "repl";
+        main = "";
+        buildFile = "axon.toml";
+        return true;
+    }
+
     if (!exists(buildFile) || !is_regular_file(buildFile)) {
         std::cout << "File " << buildFile.string() << " does not exist" << std::endl;
         return false;
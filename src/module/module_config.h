@@ -2,8 +2,19 @@
 
 #include <filesystem>
 
+enum CompileMode {
+    // Compile to a bitcode / ir file
+    MODE_BUILD,
+    // Compile and immediately run main in process
+    MODE_RUN,
+    // Read, compile and run statements from stdin one entry at a time
+    MODE_REPL,
+};
+
 class ModuleConfig {
 public:
+    CompileMode mode;
+
     std::string name;
     std::string main;
 
@@ -12,6 +23,36 @@ public:
 
     bool outputLL;
 
+    // 0-3, matching clang's -O levels
+    int optLevel;
+
+    // Run mode only: compile functions on their first call instead of up front
+    bool lazyJIT;
+
+    // Build mode only: rebuild whenever a unit changes, recompiling only what's affected
+    bool watch;
+
+    // Emit DWARF debug info (-g)
+    bool debugInfo;
+
+    // Call __axon_func_enter / __axon_func_exit around every function body (see runtime/trace.c)
+    bool instrumentFunctions;
+
+    // Count executions of every block, reported by runtime/coverage.c
+    bool coverage;
+
+    // Route allocations through runtime/alloc_profile.c, tagged with their allocation site
+    bool allocProfile;
+
+    // Profile guided optimization: instrument the build to write a raw profile, or optimize with a merged profile
+    bool profileGenerate;
+    std::optional<std::filesystem::path> profileUse;
+
+    // profiling
+    bool timeReport;
+    std::optional<std::filesystem::path> timeTrace;
+    bool memReport;
+
     bool parseArgs(int argc, char* argv[]);
 
     bool parseConfig();
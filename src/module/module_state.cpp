@@ -1,9 +1,16 @@
+#include <format>
 #include <ostream>
 #include <iostream>
+#include <unordered_set>
+#include <llvm/Bitcode/BitcodeReader.h>
 #include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Linker/Linker.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Passes/CodeGenPassBuilder.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Passes/StandardInstrumentations.h>
 #include <llvm/Support/FileSystem.h>
+#include <llvm/Support/VirtualFileSystem.h>
 
 #include "module_state.h"
 #include "logging.h"
@@ -12,6 +19,8 @@
 #include "ast/ast.h"
 #include "utils.h"
 #include "lexer/lexer.h"
+#include "memory.h"
+#include "timing.h"
 
 using namespace llvm;
 
@@ -30,6 +39,11 @@ ModuleState::ModuleState(const ModuleConfig& config): config(config) {
     arrFatPtrTy = StructType::create(*ctx, elements, "$arrFatPtrTy");
 
     scopeStack.push_back(std::vector<std::string>());
+
+    if (config.debugInfo) {
+        module->addModuleFlag(Module::Warning, "Debug Info Version", DEBUG_METADATA_VERSION);
+        module->addModuleFlag(Module::Warning, "Dwarf Version", 4);
+    }
 }
 
 ModuleState::~ModuleState() = default;
@@ -66,10 +80,21 @@ bool ModuleState::registerUnit(const std::string& unit) {
 
         units[unit] = nullptr;
         unitStack.push_back(unit);
+        if (registrations) {
+            registrations->units.push_back(unit);
+        }
     }
     return true;
 }
 
+bool ModuleState::registerImport(const std::string& unit, const std::string& imported) {
+    unitImports[unit].push_back(imported);
+    if (registrations) {
+        registrations->imports.emplace_back(unit, imported);
+    }
+    return registerUnit(imported);
+}
+
 bool ModuleState::registerGlobalIdentifier(const std::string& unit,
                                            const std::string& identifier,
                                            std::unique_ptr<Identifier> val) {
@@ -78,6 +103,9 @@ bool ModuleState::registerGlobalIdentifier(const std::string& unit,
         return false;
     }
     globalIdentifiers.insert_or_assign(globalIdentifier, std::move(val));
+    if (registrations) {
+        registrations->globalIdentifiers.push_back(globalIdentifier);
+    }
     return true;
 }
 
@@ -92,13 +120,138 @@ bool ModuleState::useGlobalIdentifier(const std::string& unit,
     return registerIdentifier(alias, std::make_unique<Identifier>(*globalIdentifiers.at(globalIdentifier)));
 }
 
-bool ModuleState::compileModule() {
-    std::unordered_map<std::string, Lexer> lexers;
+bool ModuleState::registerStructType(const std::string& unit, const std::string& name, StructType* inlineType) {
+    auto qualifiedName = unit + "." + name;
+    auto [it, inserted] = structTypes.try_emplace(qualifiedName, inlineType);
+    if (inserted && registrations) {
+        registrations->structTypes.push_back(qualifiedName);
+    }
+    return inserted || it->second == inlineType;
+}
+
+void ModuleState::enterTypeUnit(const std::string& unit) {
+    typeUnit = unit;
+}
+
+StructType* ModuleState::getInlineStructType(const std::string& unit, const std::string& name) const {
+    auto it = structTypes.find(unit + "." + name);
+    return it != structTypes.end() ? it->second : nullptr;
+}
+
+StructType* ModuleState::getInlineStructType(const std::string& name) const {
+    if (auto it = structTypes.find(typeUnit + "." + name); it != structTypes.end()) {
+        return it->second;
+    }
+    StructType* found = nullptr;
+    for (const auto& [qualifiedName, inlineType]: structTypes) {
+        auto separator = qualifiedName.rfind('.');
+        if (!inlineType || qualifiedName.compare(separator + 1, std::string::npos, name) != 0) {
+            continue;
+        }
+        // Inline structs of the same name in different units are ambiguous here
+        if (found && found != inlineType) {
+            return nullptr;
+        }
+        found = inlineType;
+    }
+    return found;
+}
 
+bool ModuleState::compileModule() {
     if (!registerUnit(config.main)) {
         logError("Error reading main unit specified in build config");
         return false;
     }
+    if (!compileUnits()) {
+        return false;
+    }
+    finalizeDebugInfo();
+    emitInstrumentationTable();
+    emitCoverageTable();
+    emitAllocSiteTable();
+    return true;
+}
+
+struct CachedUnit {
+    std::filesystem::file_time_type modified;
+    uintmax_t size;
+    std::shared_ptr<Lexer> lexer;
+    std::shared_ptr<UnitAST> ast;
+    UnitMemory memory;
+};
+
+static bool unitCacheEnabled = false;
+// Keyed by path and unit name, since the unit name is part of the AST
+static std::unordered_map<std::string, CachedUnit> unitCache;
+
+// Bitcode of every unit from the last successful build, for incremental (watch mode and daemon) builds
+static std::unordered_map<std::string, SmallVector<char, 0> > codegenCache;
+
+// The daemon builds any number of modules, so units are keyed by path too. Which unit is main changes the code of
+// that unit (its main isn't prefixed), so it's part of the key as well.
+std::string ModuleState::codegenCacheKey(const std::string& unit) {
+    return unitToPath(unit).string() + ":" + unit + ":" + config.main;
+}
+
+void ModuleState::enableUnitCache() {
+    unitCacheEnabled = true;
+}
+
+std::shared_ptr<UnitAST> ModuleState::loadUnit(const std::string& unit, const std::filesystem::path& file) {
+    auto cacheKey = file.string() + ":" + unit;
+    std::error_code modifiedError;
+    std::error_code sizeError;
+    auto modified = last_write_time(file, modifiedError);
+    auto size = file_size(file, sizeError);
+    // A file that can't be stat'ed is always parsed again and never cached
+    auto cacheable = unitCacheEnabled && !modifiedError && !sizeError;
+    if (cacheable && unitCache.contains(cacheKey)) {
+        const auto& cached = unitCache.at(cacheKey);
+        if (cached.modified == modified && cached.size == size) {
+            lexers[unit] = cached.lexer;
+            unitMemory[unit] = cached.memory;
+            return cached.ast;
+        }
+    }
+
+    std::string text;
+    {
+        PhaseTimer timer("read file", unit);
+        text = readFile(file);
+    }
+    std::shared_ptr<Lexer> lexer;
+    {
+        PhaseTimer timer("lex", unit);
+        lexer = std::make_shared<Lexer>(text);
+    }
+    lexers[unit] = lexer;
+    changedUnits.insert(unit);
+    // Code from an older version of the unit must not be reused, even if this build fails before replacing it
+    codegenCache.erase(codegenCacheKey(unit));
+    std::shared_ptr<UnitAST> unitAst;
+    auto nodesBefore = AST::liveNodes();
+    auto bytesBefore = AST::liveBytes();
+    {
+        PhaseTimer timer("parse", unit);
+        unitAst = parseUnit(*lexer, unit);
+    }
+    unitMemory[unit] = UnitMemory(lexer->tokenCount(),
+                                  lexer->tokenBytes(),
+                                  AST::liveNodes() - nodesBefore,
+                                  AST::liveBytes() - bytesBefore);
+    if (!unitAst) {
+        logError(lexer->formatParsingError(unit, file.string()));
+        return nullptr;
+    }
+
+    if (cacheable) {
+        unitCache.insert_or_assign(cacheKey, CachedUnit(modified, size, lexer, unitAst, unitMemory[unit]));
+    }
+    return unitAst;
+}
+
+bool ModuleState::compileUnits() {
+    std::vector<std::string> newUnits;
     while (unitStack.size() > 0) {
         auto curUnit = unitStack.back();
         unitStack.pop_back();
@@ -106,35 +259,652 @@ bool ModuleState::compileModule() {
 
         auto curFile = unitToPath(curUnit);
         assert(is_regular_file(curFile));
-        std::string text = readFile(curFile);
-        lexers.emplace(curUnit, Lexer(text));
-        auto unitAst = parseUnit(lexers.at(curUnit), curUnit);
+        auto unitAst = loadUnit(curUnit, curFile);
         if (!unitAst) {
-            logError(lexers.at(curUnit).formatParsingError(curUnit, curFile.string()));
             return false;
         }
-
-        if (!unitAst->preregisterUnit(*this)) {
-            assert(buildErrorDebugInfo);
-            logError(lexers.at(curUnit).formatError(*buildErrorDebugInfo, curUnit, curFile.string(), buildError));
+        // Only types (and imports) so far; declarations need the types of inline structs from units not loaded yet
+        if (!unitAst->registerTypes(*this)) {
+            logError(formatBuildError(*lexers.at(curUnit), curUnit, curFile.string()));
             return false;
         }
         units[curUnit] = std::move(unitAst);
+        newUnits.push_back(curUnit);
+    }
+
+    for (const auto& curUnit: newUnits) {
+        if (incrementalCodegen()) {
+            enterUnitModule(curUnit);
+        }
+        auto registered = units.at(curUnit)->preregisterUnit(*this);
+        if (incrementalCodegen()) {
+            exitUnitModule(curUnit);
+        }
+        if (!registered) {
+            logError(formatBuildError(*lexers.at(curUnit), curUnit, unitToPath(curUnit).string()));
+            return false;
+        }
+    }
+
+    if (incrementalCodegen()) {
+        return codegenUnitsIncrementally(newUnits);
+    }
+    for (const auto& curUnit: newUnits) {
+        if (!units.at(curUnit)->codegen(*this)) {
+            logError(formatBuildError(*lexers.at(curUnit), curUnit, unitToPath(curUnit).string()));
+            return false;
+        }
+    }
+    recompiledUnits = newUnits.size();
+    return codegenReachable();
+}
+
+bool ModuleState::codegenReachable() {
+    // Bodies generated late can reach functions of units that were already codegenned, so revisit those units
+    bool progress = true;
+    while (progress) {
+        progress = false;
+        for (const auto& [unit, queue]: queuedBodies) {
+            if (queue.empty()) {
+                continue;
+            }
+            progress = true;
+            if (!units.at(unit)->codegenQueued(*this)) {
+                logError(formatBuildError(*lexers.at(unit), unit, unitToPath(unit).string()));
+                return false;
+            }
+            // The queue map may have grown while generating, so start over
+            break;
+        }
+    }
+
+    for (const auto& name: deferredBodies | std::views::keys) {
+        auto* function = module->getFunction(name);
+        if (function && function->use_empty()) {
+            function->eraseFromParent();
+        }
+    }
+
+    // fastcc is only safe while every call is direct; anything that escapes as a pointer has to use the C convention
+    for (auto& function: *module) {
+        if (function.getCallingConv() != CallingConv::Fast || !function.hasAddressTaken()) {
+            continue;
+        }
+        function.setCallingConv(CallingConv::C);
+        for (auto* user: function.users()) {
+            if (auto* call = dyn_cast<CallBase>(user); call && call->getCalledFunction() == &function) {
+                call->setCallingConv(CallingConv::C);
+            }
+        }
+    }
+    return true;
+}
+
+void ModuleState::enterUnitModule(const std::string& unit) {
+    if (!unitModules.contains(unit)) {
+        unitModules[unit] = std::make_unique<Module>(unit, *ctx);
+    }
+    std::swap(module, unitModules.at(unit));
+    // Interned strings are globals of a specific module
+    internedStrings.clear();
+}
+
+void ModuleState::exitUnitModule(const std::string& unit) {
+    builder->ClearInsertionPoint();
+    std::swap(module, unitModules.at(unit));
+    internedStrings.clear();
+}
+
+bool ModuleState::codegenUnitsIncrementally(const std::vector<std::string>& newUnits) {
+    // Units depend on the declarations of everything they import, so a change dirties every unit importing it
+    std::unordered_set<std::string> dirty;
+    for (const auto& unit: newUnits) {
+        if (changedUnits.contains(unit) || !codegenCache.contains(codegenCacheKey(unit))) {
+            dirty.insert(unit);
+        }
     }
-    for (const auto& [curUnit, unitAst]: units) {
-        if (!unitAst->codegen(*this)) {
-            assert(buildErrorDebugInfo);
-            logError(lexers.at(curUnit).formatError(*buildErrorDebugInfo,
-                                                    curUnit,
-                                                    unitToPath(curUnit).string(),
-                                                    buildError));
+    // Imports can be cyclic, so iterate until nothing new gets dirtied
+    bool grew = true;
+    while (grew) {
+        grew = false;
+        for (const auto& unit: newUnits) {
+            if (dirty.contains(unit) || !unitImports.contains(unit)) {
+                continue;
+            }
+            auto importsDirty = std::ranges::any_of(unitImports.at(unit),
+                                                    [&](const auto& imported) { return dirty.contains(imported); });
+            if (importsDirty) {
+                dirty.insert(unit);
+                grew = true;
+            }
+        }
+    }
+
+    for (const auto& unit: newUnits) {
+        if (!dirty.contains(unit)) {
+            continue;
+        }
+        enterUnitModule(unit);
+        auto success = units.at(unit)->codegen(*this);
+        exitUnitModule(unit);
+        if (!success) {
+            codegenCache.erase(codegenCacheKey(unit));
+            logError(formatBuildError(*lexers.at(unit), unit, unitToPath(unit).string()));
             return false;
         }
+
+        SmallVector<char, 0> bitcode;
+        raw_svector_ostream stream(bitcode);
+        WriteBitcodeToFile(*unitModules.at(unit), stream);
+        codegenCache.insert_or_assign(codegenCacheKey(unit), std::move(bitcode));
     }
+    recompiledUnits = dirty.size();
+
+    // Clean units were still preregistered (their identifiers are needed), but their code comes from the cache
+    for (const auto& unit: newUnits) {
+        auto unitModule = std::move(unitModules.at(unit));
+        if (!dirty.contains(unit)) {
+            const auto& bitcode = codegenCache.at(codegenCacheKey(unit));
+            auto cached = parseBitcodeFile(MemoryBufferRef(StringRef(bitcode.data(), bitcode.size()), unit), *ctx);
+            if (!cached) {
+                logError("Could not load cached code for unit " + unit + ": " + toString(cached.takeError()));
+                return false;
+            }
+            unitModule = std::move(*cached);
+        }
+        if (Linker::linkModules(*module, std::move(unitModule))) {
+            logError("Could not link unit " + unit);
+            return false;
+        }
+    }
+    unitModules.clear();
     return true;
 }
 
+std::vector<std::filesystem::path> ModuleState::unitPaths() {
+    std::vector<std::filesystem::path> paths;
+    for (const auto& unit: units | std::views::keys) {
+        paths.push_back(unitToPath(unit));
+    }
+    return paths;
+}
+
+size_t ModuleState::unitCount() const {
+    return units.size();
+}
+
+size_t ModuleState::recompiledUnitCount() const {
+    return recompiledUnits;
+}
+
+std::string ModuleState::formatBuildError(Lexer& lexer, const std::string& unit, const std::string& filename) {
+    assert(buildErrorDebugInfo);
+    return lexer.formatError(*buildErrorDebugInfo, unit, filename, buildError);
+}
+
+std::unique_ptr<Module> ModuleState::startModule(const std::string& name) {
+    builder->ClearInsertionPoint();
+    // Interned strings are globals of the old module
+    internedStrings.clear();
+    return std::exchange(module, std::make_unique<Module>(name, *ctx));
+}
+
+void ModuleState::recordRegistrations() {
+    registrations.emplace();
+}
+
+void ModuleState::keepRegistrations() {
+    registrations.reset();
+}
+
+void ModuleState::undoRegistrations() {
+    if (!registrations) {
+        return;
+    }
+    for (const auto& identifier: registrations->identifiers) {
+        identifiers.erase(identifier);
+        for (auto& scope: scopeStack) {
+            std::erase(scope, identifier);
+        }
+    }
+    for (const auto& identifier: registrations->globalIdentifiers) {
+        globalIdentifiers.erase(identifier);
+    }
+    for (const auto& identifier: registrations->structTypes) {
+        structTypes.erase(identifier);
+    }
+    for (const auto& [unit, imported]: registrations->imports | std::views::reverse) {
+        auto& imports = unitImports.at(unit);
+        imports.erase(std::next(std::find(imports.rbegin(), imports.rend(), imported)).base());
+    }
+    // Units the entry brought in are loaded again (and their code generated again) by the next entry importing them
+    for (const auto& unit: registrations->units) {
+        units.erase(unit);
+        lexers.erase(unit);
+        unitMemory.erase(unit);
+        changedUnits.erase(unit);
+        std::erase(unitStack, unit);
+    }
+    registrations.reset();
+}
+
+void ModuleState::enterCodegenUnit(const std::string& unit) {
+    codegenUnit = unit;
+    if (!config.debugInfo) {
+        return;
+    }
+    if (debugUnits.contains(unit)) {
+        return;
+    }
+    auto path = absolute(unitToPath(unit));
+    auto builder = std::make_unique<DIBuilder>(*module);
+    auto* file = builder->createFile(path.filename().string(), path.parent_path().string());
+    // DWARF has no language code for Axon, and C is the closest match for what debuggers can evaluate
+    auto* compileUnit = builder->createCompileUnit(dwarf::DW_LANG_C, file, "axon", config.optLevel > 0, "", 0);
+    debugUnits.emplace(unit, DebugUnit(std::move(builder), compileUnit, file, {}));
+}
+
+DIType* ModuleState::debugType(GeneratedType* type) {
+    auto& unit = debugUnits.at(codegenUnit);
+    auto* genStruct = type->getGenStruct(*this);
+    // Owned and borrowed struct types share a debug type
+    auto* key = genStruct ? genStruct->type : type;
+    if (unit.types.contains(key)) {
+        return unit.types.at(key);
+    }
+
+    auto& diBuilder = *unit.builder;
+    auto pointerBits = dl->getPointerSizeInBits();
+    DIType* diType;
+    if (type->isVoid()) {
+        diType = nullptr;
+    } else if (type->isPrimitive()) {
+        auto encoding = type->isBool()
+                            ? dwarf::DW_ATE_boolean
+                            : type->isFloating()
+                                  ? dwarf::DW_ATE_float
+                                  : type->isSigned()
+                                        ? dwarf::DW_ATE_signed
+                                        : dwarf::DW_ATE_unsigned;
+        diType = diBuilder.createBasicType(type->toString(),
+                                            dl->getTypeAllocSizeInBits(type->getLLVMType(*this)),
+                                            encoding);
+    } else if (type->isArray()) {
+        auto* layout = dl->getStructLayout(arrFatPtrTy);
+        auto* base = debugType(type->getArrayBase());
+        auto* size = diBuilder.createBasicType("usize", dl->getTypeAllocSizeInBits(sizeTy), dwarf::DW_ATE_unsigned);
+        SmallVector<Metadata*> members{
+            diBuilder.createMemberType(unit.compileUnit, "data", unit.file, 0, pointerBits, 0,
+                                     layout->getElementOffsetInBits(0), DINode::FlagZero,
+                                     diBuilder.createPointerType(base, pointerBits)),
+            diBuilder.createMemberType(unit.compileUnit, "size", unit.file, 0, size->getSizeInBits(), 0,
+                                     layout->getElementOffsetInBits(1), DINode::FlagZero, size),
+        };
+        diType = diBuilder.createStructType(unit.compileUnit, type->toString(), unit.file, 0,
+                                             layout->getSizeInBits(), 0, DINode::FlagZero, nullptr,
+                                             diBuilder.getOrCreateArray(members));
+    } else if (type->isVector()) {
+        auto* llvmType = type->getLLVMType(*this);
+        SmallVector<Metadata*> subscripts{diBuilder.getOrCreateSubrange(0, type->getVectorLanes())};
+        diType = diBuilder.createVectorType(dl->getTypeAllocSizeInBits(llvmType),
+                                            dl->getABITypeAlign(llvmType).value() * 8,
+                                            debugType(type->getVectorElement()),
+                                            diBuilder.getOrCreateArray(subscripts));
+    } else if (type->isFunction()) {
+        SmallVector<Metadata*> signature{debugType(type->getReturnType())};
+        for (auto* arg: type->getArgs()) {
+            signature.push_back(debugType(arg));
+        }
+        diType = diBuilder.createPointerType(
+            diBuilder.createSubroutineType(diBuilder.getOrCreateTypeArray(signature)),
+            pointerBits);
+    } else if (genStruct) {
+        // Struct values are pointers to the struct, unless it's inline. The type is cached before the fields are
+        // described, since fields can refer back to the struct itself.
+        auto* layout = dl->getStructLayout(genStruct->structType);
+        auto* composite = diBuilder.createStructType(unit.compileUnit, genStruct->type->toString(), unit.file, 0,
+                                                   layout->getSizeInBits(), 0, DINode::FlagZero, nullptr,
+                                                   DINodeArray());
+        diType = genStruct->isInline
+                     ? static_cast<DIType*>(composite)
+                     : diBuilder.createPointerType(composite, pointerBits);
+        unit.types.insert_or_assign(key, diType);
+
+        SmallVector<Metadata*> members;
+        for (int i = 0; i < genStruct->fields.size(); i++) {
+            const auto& [fieldName, fieldType] = genStruct->fields[i];
+            members.push_back(diBuilder.createMemberType(
+                composite, fieldName, unit.file, 0,
+                dl->getTypeAllocSizeInBits(fieldType->getLLVMType(*this)), 0,
+                layout->getElementOffsetInBits(i), DINode::FlagZero, debugType(fieldType)));
+        }
+        diBuilder.replaceArrays(composite, diBuilder.getOrCreateArray(members));
+        return diType;
+    } else {
+        diType = diBuilder.createUnspecifiedType(type->toString());
+    }
+    unit.types.insert_or_assign(key, diType);
+    return diType;
+}
+
+void ModuleState::beginDebugFunction(Function* function, const std::string& name, const DebugInfo& debugInfo) {
+    if (!config.debugInfo) {
+        return;
+    }
+    auto& unit = debugUnits.at(codegenUnit);
+    auto line = lexers.at(codegenUnit)->tokenLocation(debugInfo.startToken).first;
+
+    auto* functionType = functionStack.back()->type;
+    SmallVector<Metadata*> signature{debugType(functionType->getReturnType())};
+    for (auto* arg: functionType->getArgs()) {
+        signature.push_back(debugType(arg));
+    }
+    auto flags = DISubprogram::SPFlagDefinition;
+    if (config.optLevel > 0) {
+        flags |= DISubprogram::SPFlagOptimized;
+    }
+    if (function->hasLocalLinkage()) {
+        flags |= DISubprogram::SPFlagLocalToUnit;
+    }
+    auto* subprogram = unit.builder->createFunction(unit.file,
+                                                    name,
+                                                    function->getName(),
+                                                    unit.file,
+                                                    line,
+                                                    unit.builder->createSubroutineType(
+                                                        unit.builder->getOrCreateTypeArray(signature)),
+                                                    line,
+                                                    DINode::FlagPrototyped,
+                                                    flags);
+    function->setSubprogram(subprogram);
+    setDebugLocation(debugInfo);
+}
+
+void ModuleState::endDebugFunction() {
+    builder->SetCurrentDebugLocation(DebugLoc());
+}
+
+void ModuleState::setDebugLocation(const DebugInfo& debugInfo) {
+    if (!config.debugInfo) {
+        return;
+    }
+    auto* subprogram = builder->GetInsertBlock()->getParent()->getSubprogram();
+    if (!subprogram) {
+        return;
+    }
+    auto [line, column] = lexers.at(codegenUnit)->tokenLocation(debugInfo.startToken);
+    builder->SetCurrentDebugLocation(DILocation::get(*ctx, line, column, subprogram));
+}
+
+void ModuleState::describeVariable(const std::string& identifier,
+                                   GeneratedType* type,
+                                   AllocaInst* varAlloca,
+                                   const unsigned argNo) {
+    if (!config.debugInfo) {
+        return;
+    }
+    auto* subprogram = builder->GetInsertBlock()->getParent()->getSubprogram();
+    auto location = builder->getCurrentDebugLocation();
+    if (!subprogram || !location) {
+        return;
+    }
+    auto& unit = debugUnits.at(codegenUnit);
+    auto* variable = argNo > 0
+                         ? unit.builder->createParameterVariable(subprogram, identifier, argNo, unit.file,
+                                                                 location.getLine(), debugType(type), true)
+                         : unit.builder->createAutoVariable(subprogram, identifier, unit.file, location.getLine(),
+                                                            debugType(type), true);
+    unit.builder->insertDeclare(varAlloca,
+                                variable,
+                                unit.builder->createExpression(),
+                                location.get(),
+                                builder->GetInsertBlock());
+}
+
+void ModuleState::finalizeDebugInfo() {
+    for (auto& unit: debugUnits | std::views::values) {
+        unit.builder->finalize();
+    }
+    // The builders untrack their metadata when they're destroyed, so they have to go while the context still exists;
+    // in run mode the context is handed to the JIT, which is destroyed before this state
+    debugUnits.clear();
+}
+
+// The hooks in runtime/trace.c only record an event and always return, which lets instrumented functions still be
+// inferred willreturn
+static FunctionCallee getTraceHook(Module& module, IRBuilder<>& builder, const std::string& name) {
+    auto hook = module.getOrInsertFunction(name, builder.getVoidTy(), builder.getInt32Ty());
+    if (auto* function = dyn_cast<Function>(hook.getCallee())) {
+        function->addFnAttr(Attribute::WillReturn);
+        function->addFnAttr(Attribute::NoUnwind);
+    }
+    return hook;
+}
+
+void ModuleState::instrumentEntry(Function* function) {
+    if (!config.instrumentFunctions) {
+        return;
+    }
+    auto id = static_cast<uint32_t>(instrumentedNames.size());
+    instrumentedNames.push_back(function->getName().str());
+    instrumentedIds.insert_or_assign(function, id);
+    auto hook = getTraceHook(*module, *builder, "__axon_func_enter");
+    builder->CreateCall(hook, {builder->getInt32(id)});
+}
+
+void ModuleState::instrumentExit() {
+    if (!config.instrumentFunctions) {
+        return;
+    }
+    auto id = instrumentedIds.at(builder->GetInsertBlock()->getParent());
+    auto hook = getTraceHook(*module, *builder, "__axon_func_exit");
+    builder->CreateCall(hook, {builder->getInt32(id)});
+}
+
+void ModuleState::emitInstrumentationTable() {
+    if (!config.instrumentFunctions) {
+        return;
+    }
+    std::vector<Constant*> names;
+    for (const auto& name: instrumentedNames) {
+        names.push_back(builder->CreateGlobalString(name, "func_name", 0, module.get()));
+    }
+    auto* tableType = ArrayType::get(PointerType::getUnqual(*ctx), names.size());
+    new GlobalVariable(*module,
+                       tableType,
+                       true,
+                       GlobalValue::ExternalLinkage,
+                       ConstantArray::get(tableType, names),
+                       "__axon_func_names");
+    new GlobalVariable(*module,
+                       builder->getInt32Ty(),
+                       true,
+                       GlobalValue::ExternalLinkage,
+                       builder->getInt32(names.size()),
+                       "__axon_func_count");
+}
+
+void ModuleState::coverRegion(const DebugInfo& debugInfo) {
+    if (!config.coverage) {
+        return;
+    }
+    auto& lexer = *lexers.at(codegenUnit);
+    auto [startLine, startColumn] = lexer.tokenLocation(debugInfo.startToken);
+    auto [endLine, endColumn] = lexer.tokenLocation(debugInfo.endToken - 1);
+    auto index = coverageRegions.size();
+    coverageRegions.push_back(CoverageRegion(absolute(unitToPath(codegenUnit)).string(),
+                                             startLine,
+                                             startColumn,
+                                             endLine,
+                                             endColumn));
+
+    auto* counterTy = builder->getInt64Ty();
+    if (!coverageCounters) {
+        coverageCounters = new GlobalVariable(*module,
+                                              counterTy,
+                                              false,
+                                              GlobalValue::ExternalLinkage,
+                                              nullptr,
+                                              "coverage_counters_placeholder");
+    }
+    // Plain increments like gcov; counts from racing threads can get lost, but they stay cheap
+    auto* counter = builder->CreateConstGEP1_64(counterTy, coverageCounters, index, "coverage_counter");
+    auto* count = builder->CreateLoad(counterTy, counter, "coverage_count");
+    builder->CreateStore(builder->CreateAdd(count, builder->getInt64(1)), counter);
+}
+
+void ModuleState::emitCoverageTable() {
+    if (!config.coverage) {
+        return;
+    }
+    auto* i32Ty = builder->getInt32Ty();
+    auto* countersType = ArrayType::get(builder->getInt64Ty(), coverageRegions.size());
+    auto* counters = new GlobalVariable(*module,
+                                        countersType,
+                                        false,
+                                        GlobalValue::ExternalLinkage,
+                                        ConstantAggregateZero::get(countersType),
+                                        "__axon_coverage_counters");
+    if (coverageCounters) {
+        coverageCounters->replaceAllUsesWith(counters);
+        coverageCounters->eraseFromParent();
+        coverageCounters = nullptr;
+    }
+
+    // Matches AxonCoverageRegion in runtime/coverage.c
+    auto* regionType = StructType::get(*ctx, {PointerType::getUnqual(*ctx), i32Ty, i32Ty, i32Ty, i32Ty});
+    std::unordered_map<std::string, Constant*> files;
+    std::vector<Constant*> regions;
+    for (const auto& [file, startLine, startColumn, endLine, endColumn]: coverageRegions) {
+        if (!files.contains(file)) {
+            files[file] = builder->CreateGlobalString(file, "coverage_file", 0, module.get());
+        }
+        regions.push_back(ConstantStruct::get(regionType,
+                                              {
+                                                  files.at(file),
+                                                  builder->getInt32(startLine),
+                                                  builder->getInt32(startColumn),
+                                                  builder->getInt32(endLine),
+                                                  builder->getInt32(endColumn)
+                                              }));
+    }
+    auto* tableType = ArrayType::get(regionType, regions.size());
+    new GlobalVariable(*module,
+                       tableType,
+                       true,
+                       GlobalValue::ExternalLinkage,
+                       ConstantArray::get(tableType, regions),
+                       "__axon_coverage_regions");
+    new GlobalVariable(*module,
+                       i32Ty,
+                       true,
+                       GlobalValue::ExternalLinkage,
+                       builder->getInt32(regions.size()),
+                       "__axon_coverage_count");
+}
+
+uint32_t ModuleState::registerAllocSite(GeneratedType* type, const DebugInfo& debugInfo) {
+    auto line = lexers.at(codegenUnit)->tokenLocation(debugInfo.startToken).first;
+    allocSites.push_back(AllocSite(codegenUnit,
+                                   builder->GetInsertBlock()->getParent()->getName().str(),
+                                   line,
+                                   type->toString()));
+    return allocSites.size() - 1;
+}
+
+void ModuleState::emitAllocSiteTable() {
+    if (!config.allocProfile) {
+        return;
+    }
+    // Matches AxonAllocSite in runtime/alloc_profile.c
+    auto* ptrTy = PointerType::getUnqual(*ctx);
+    auto* siteType = StructType::get(*ctx, {ptrTy, ptrTy, builder->getInt32Ty(), ptrTy});
+    std::vector<Constant*> sites;
+    for (const auto& [unit, function, line, type]: allocSites) {
+        sites.push_back(ConstantStruct::get(siteType,
+                                            {
+                                                builder->CreateGlobalString(unit, "alloc_unit", 0, module.get()),
+                                                builder->CreateGlobalString(function, "alloc_func", 0, module.get()),
+                                                builder->getInt32(line),
+                                                builder->CreateGlobalString(type, "alloc_type", 0, module.get())
+                                            }));
+    }
+    auto* tableType = ArrayType::get(siteType, sites.size());
+    new GlobalVariable(*module,
+                       tableType,
+                       true,
+                       GlobalValue::ExternalLinkage,
+                       ConstantArray::get(tableType, sites),
+                       "__axon_alloc_sites");
+    new GlobalVariable(*module,
+                       builder->getInt32Ty(),
+                       true,
+                       GlobalValue::ExternalLinkage,
+                       builder->getInt32(sites.size()),
+                       "__axon_alloc_site_count");
+}
+
+bool ModuleState::optimize() {
+    PhaseTimer timer("optimize");
+    optimizeModule(*module, config);
+    return true;
+}
+
+static std::optional<PGOOptions> pgoOptions(const ModuleConfig& config) {
+    PGOOptions::PGOAction action;
+    std::string profileFile;
+    if (config.profileGenerate) {
+        // An empty file name lets the profile runtime pick the name (default.profraw or $LLVM_PROFILE_FILE)
+        action = PGOOptions::IRInstr;
+    } else if (config.profileUse.has_value()) {
+        action = PGOOptions::IRUse;
+        profileFile = config.profileUse->string();
+    } else {
+        return std::nullopt;
+    }
+    return PGOOptions(profileFile, "", "", "", vfs::getRealFileSystem(), action);
+}
+
+void ModuleState::optimizeModule(Module& module, const ModuleConfig& config) {
+    LoopAnalysisManager lam;
+    FunctionAnalysisManager fam;
+    CGSCCAnalysisManager cgam;
+    ModuleAnalysisManager mam;
+
+    // Standard instrumentations report each pass to the time trace profiler when it's enabled
+    PassInstrumentationCallbacks pic;
+    StandardInstrumentations si(module.getContext(), false);
+    si.registerCallbacks(pic, &mam);
+
+    // Instrumentation and profile use both happen on IR at the start of the pipeline, so the counters line up as long
+    // as the instrumented and optimized builds use the same opt level
+    PassBuilder pb(nullptr, PipelineTuningOptions(), pgoOptions(config), &pic);
+    pb.registerModuleAnalyses(mam);
+    pb.registerCGSCCAnalyses(cgam);
+    pb.registerFunctionAnalyses(fam);
+    pb.registerLoopAnalyses(lam);
+    pb.crossRegisterProxies(lam, fam, cgam, mam);
+
+    ModulePassManager mpm;
+    switch (config.optLevel) {
+        case 0:
+            mpm = pb.buildO0DefaultPipeline(OptimizationLevel::O0);
+            break;
+        case 1:
+            mpm = pb.buildPerModuleDefaultPipeline(OptimizationLevel::O1);
+            break;
+        case 2:
+            mpm = pb.buildPerModuleDefaultPipeline(OptimizationLevel::O2);
+            break;
+        default:
+            mpm = pb.buildPerModuleDefaultPipeline(OptimizationLevel::O3);
+            break;
+    }
+    mpm.run(module, mam);
+}
+
 bool ModuleState::writeIR() {
+    PhaseTimer timer("write IR");
     raw_fd_ostream* out;
     if (config.outputFile.has_value()) {
         std::error_code EC;
@@ -160,6 +930,58 @@ bool ModuleState::writeIR() {
     return true;
 }
 
+void ModuleState::printMemReport(std::ostream& out) {
+    constexpr double MiB = 1024 * 1024;
+
+    out << "===== Axon memory report =====" << std::endl;
+    out << std::format("peak RSS: {:.2f} MiB", peakRSS() / MiB) << std::endl;
+
+    // Biggest units first, since those are the ones worth looking at
+    std::vector<std::pair<std::string, UnitMemory> > sortedUnits(unitMemory.begin(), unitMemory.end());
+    std::ranges::sort(sortedUnits,
+                      [](const auto& a, const auto& b) {
+                          return a.second.tokenBytes + a.second.astBytes > b.second.tokenBytes + b.second.astBytes;
+                      });
+    UnitMemory totals(0, 0, 0, 0);
+    // AST bytes only count the nodes themselves; the strings and vectors they own aren't tracked
+    out << std::format("{:>10} {:>12} {:>10} {:>12}  {}", "Tokens", "Token bytes", "AST nodes", "~AST bytes", "Unit")
+            << std::endl;
+    for (const auto& [unit, memory]: sortedUnits) {
+        out << std::format("{:>10} {:>12} {:>10} {:>12}  {}",
+                           memory.tokens,
+                           memory.tokenBytes,
+                           memory.astNodes,
+                           memory.astBytes,
+                           unit) << std::endl;
+        totals.tokens += memory.tokens;
+        totals.tokenBytes += memory.tokenBytes;
+        totals.astNodes += memory.astNodes;
+        totals.astBytes += memory.astBytes;
+    }
+    out << std::format("{:>10} {:>12} {:>10} {:>12}  {}",
+                       totals.tokens,
+                       totals.tokenBytes,
+                       totals.astNodes,
+                       totals.astBytes,
+                       "total") << std::endl;
+
+    // Each type is its own allocation plus a hash node in the interning table
+    auto typeCount = GeneratedType::registeredCount();
+    auto typeBytes = typeCount * (sizeof(GeneratedType) + sizeof(TypeBacker) + 2 * sizeof(void*));
+    out << std::format("registered types: {} (~{} bytes)", typeCount, typeBytes) << std::endl;
+
+    size_t internBytes = 0;
+    for (const auto& str: internedStrings | std::views::keys) {
+        internBytes += str.length() + 1;
+    }
+    out << std::format("interned strings: {} ({} bytes of string data)", internedStrings.size(), internBytes)
+            << std::endl;
+    // The module is handed off to the JIT in run mode
+    if (module) {
+        out << std::format("LLVM instructions: {}", module->getInstructionCount()) << std::endl;
+    }
+}
+
 AllocaInst* ModuleState::createAlloca(GeneratedType* type, const std::string& name) {
     auto oldIP = builder->saveIP();
     auto& entry = builder->GetInsertBlock()->getParent()->getEntryBlock();
@@ -169,6 +991,21 @@ AllocaInst* ModuleState::createAlloca(GeneratedType* type, const std::string& na
     return newAlloca;
 }
 
+void ModuleState::createBoundsCheck(Value* condition, const std::string& name) {
+    if (auto* constant = dyn_cast<ConstantInt>(condition); constant && constant->isOne()) {
+        return;
+    }
+    // llvm.trap is cold and noreturn, so the out of bounds block is laid out away from the hot path
+    Function* func = builder->GetInsertBlock()->getParent();
+    BasicBlock* trapBB = BasicBlock::Create(*ctx, name + "_oob", func);
+    BasicBlock* okBB = BasicBlock::Create(*ctx, name, func);
+    builder->CreateCondBr(condition, okBB, trapBB);
+    builder->SetInsertPoint(trapBB);
+    builder->CreateIntrinsic(Intrinsic::trap, {}, {});
+    builder->CreateUnreachable();
+    builder->SetInsertPoint(okBB);
+}
+
 void ModuleState::enterFunc(const GeneratedValue* function) {
     functionStack.push_back(function);
 }
@@ -199,12 +1036,39 @@ bool ModuleState::registerIdentifier(const std::string& identifier, std::unique_
     }
     identifiers.insert_or_assign(identifier, std::move(val));
     scopeStack.back().push_back(identifier);
+    if (registrations) {
+        registrations->identifiers.push_back(identifier);
+    }
     return true;
 }
 
-bool ModuleState::registerVar(const std::string& identifier, GeneratedType* type) {
+bool ModuleState::registerVar(const std::string& identifier, GeneratedType* type, const unsigned argNo) {
+    if (globalVarDepth == scopeStack.size()) {
+        if (identifiers.contains(identifier)) {
+            return false;
+        }
+        auto* llvmType = type->getLLVMType(*this);
+        auto* global = new GlobalVariable(*module,
+                                          llvmType,
+                                          false,
+                                          GlobalValue::ExternalLinkage,
+                                          Constant::getNullValue(llvmType),
+                                          "global." + identifier);
+        // Registered in the outermost scope so it isn't dropped when the defining function's scope exits
+        identifiers.insert_or_assign(identifier, std::make_unique<Identifier>(GeneratedValue(type, global)));
+        scopeStack.front().push_back(identifier);
+        if (registrations) {
+            registrations->identifiers.push_back(identifier);
+        }
+        return true;
+    }
+
     auto* varAlloca = createAlloca(type, identifier);
-    return registerIdentifier(identifier, std::make_unique<Identifier>(GeneratedValue(type, varAlloca)));
+    if (!registerIdentifier(identifier, std::make_unique<Identifier>(GeneratedValue(type, varAlloca)))) {
+        return false;
+    }
+    describeVariable(identifier, type, varAlloca, argNo);
+    return true;
 }
 
 Identifier* ModuleState::getIdentifier(const std::string& identifier) {
@@ -217,7 +1081,7 @@ Identifier* ModuleState::getIdentifier(const std::string& identifier) {
     }
 }
 
-GeneratedValue* ModuleState::getVar(const std::string& identifier) {
+std::unique_ptr<GeneratedValue> ModuleState::getVar(const std::string& identifier) {
     auto val = getIdentifier(identifier);
     if (!val) {
         return nullptr;
@@ -226,7 +1090,21 @@ GeneratedValue* ModuleState::getVar(const std::string& identifier) {
     if (!varAlloca) {
         return nullptr;
     }
-    return varAlloca;
+    if (isa<Function>(varAlloca->value)) {
+        requireBody(varAlloca->value);
+    }
+    return std::make_unique<GeneratedValue>(varAlloca->type, importGlobal(varAlloca->value));
+}
+
+Value* ModuleState::importGlobal(Value* value) {
+    auto* global = dyn_cast<GlobalValue>(value);
+    if (!global || global->getParent() == module.get()) {
+        return value;
+    }
+    if (auto* function = dyn_cast<Function>(global)) {
+        return module->getOrInsertFunction(function->getName(), function->getFunctionType()).getCallee();
+    }
+    return module->getOrInsertGlobal(global->getName(), global->getValueType());
 }
 
 GeneratedStruct* ModuleState::getStruct(const std::string& identifier) {
@@ -241,6 +1119,56 @@ GeneratedStruct* ModuleState::getStruct(const std::string& identifier) {
     return structIdentifier;
 }
 
+bool ModuleState::singleModule() const {
+    return config.mode != MODE_REPL && !incrementalCodegen();
+}
+
+bool ModuleState::incrementalCodegen() const {
+    if (config.watch) {
+        return true;
+    }
+    // The daemon reuses the code of unchanged units too, except when codegen also fills per build tables (coverage
+    // regions, trace names, allocation sites) or debug info, which cached code can't contribute to
+    return unitCacheEnabled && config.mode == MODE_BUILD && !config.debugInfo && !config.instrumentFunctions &&
+           !config.coverage && !config.allocProfile;
+}
+
+bool ModuleState::deferringBodies() const {
+    // Coverage has to see the functions nothing calls too, since that's the dead code it's meant to find
+    return singleModule() && !config.coverage;
+}
+
+void ModuleState::deferBody(const std::string& unit, const Value* function, FuncAST* body, const bool root) {
+    if (!deferringBodies()) {
+        return;
+    }
+    if (root) {
+        queuedBodies[unit].push_back(body);
+    } else {
+        deferredBodies.insert_or_assign(function->getName().str(), std::make_tuple(unit, body));
+    }
+}
+
+void ModuleState::requireBody(const Value* function) {
+    auto deferred = deferredBodies.find(function->getName().str());
+    if (deferred == deferredBodies.end()) {
+        return;
+    }
+    auto [unit, body] = deferred->second;
+    queuedBodies[unit].push_back(body);
+    deferredBodies.erase(deferred);
+}
+
+FuncAST* ModuleState::nextQueuedBody(const std::string& unit) {
+    auto queue = queuedBodies.find(unit);
+    if (queue == queuedBodies.end() || queue->second.empty()) {
+        return nullptr;
+    }
+    auto* body = queue->second.back();
+    queue->second.pop_back();
+    return body;
+}
+
 Constant* ModuleState::getInternedString(const std::string& strVal) {
     if (!internedStrings.contains(strVal)) {
         auto* internPointer =
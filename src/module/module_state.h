@@ -1,7 +1,10 @@
 #pragma once
 
 #include <filesystem>
+#include <optional>
+#include <unordered_set>
 
+#include "llvm/IR/DIBuilder.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Module.h"
 
@@ -19,11 +22,21 @@ class ModuleConfig;
 
 struct SigArg;
 class UnitAST;
+class FuncAST;
+class Lexer;
 
 struct GeneratedType;
 struct GeneratedStruct;
 struct GeneratedValue;
 
+// Per unit memory accounting for --mem-report
+struct UnitMemory {
+    size_t tokens;
+    size_t tokenBytes;
+    size_t astNodes;
+    size_t astBytes;
+};
+
 class ModuleState {
     AllocaInst* createAlloca(GeneratedType* type, const std::string& name);
 
@@ -48,16 +61,125 @@ private:
     // main compilation
     std::filesystem::path unitToPath(const std::string& unit);
 
-    std::unordered_map<std::string, std::unique_ptr<UnitAST> > units;
+    // Shared with the unit cache when it's enabled
+    std::unordered_map<std::string, std::shared_ptr<UnitAST> > units;
     std::vector<std::string> unitStack;
+    std::unordered_map<std::string, std::shared_ptr<Lexer> > lexers;
+
+    // unit -> units it imports
+    std::unordered_map<std::string, std::vector<std::string> > unitImports;
+    // Units that were actually lexed and parsed in this build, rather than taken from the unit cache
+    std::unordered_set<std::string> changedUnits;
+    size_t recompiledUnits = 0;
+
+    // Lexes and parses a unit, or takes it from the unit cache if the file hasn't changed. Logs errors.
+    std::shared_ptr<UnitAST> loadUnit(const std::string& unit, const std::filesystem::path& file);
+
+    // Incremental builds give every unit its own module, so unchanged units can reuse the code from the last build
+    std::unordered_map<std::string, std::unique_ptr<Module> > unitModules;
+
+    void enterUnitModule(const std::string& unit);
+
+    void exitUnitModule(const std::string& unit);
+
+    std::string codegenCacheKey(const std::string& unit);
+
+    // Reachability driven codegen: function bodies are only generated once they're referenced from a generated body,
+    // starting from main and exported symbols.
+    // function name -> unit and body of functions nothing has referenced yet
+    std::unordered_map<std::string, std::tuple<std::string, FuncAST*> > deferredBodies;
+    // unit -> bodies waiting to be generated
+    std::unordered_map<std::string, std::vector<FuncAST*> > queuedBodies;
+
+    // Generates queued bodies until nothing new becomes reachable, then drops declarations of unreachable functions
+    bool codegenReachable();
+
+    // Codegens the units that changed (or import a unit that did) and links them with the cached code of the rest
+    bool codegenUnitsIncrementally(const std::vector<std::string>& newUnits);
 
     std::unordered_map<std::string, std::unique_ptr<Identifier> > globalIdentifiers;
 
+    // Struct names of every unit ("unit.Name", including the names it imports), with their LLVM type if they're
+    // inline structs (nullptr otherwise). Types only know the name they're referred to by, so names are resolved in
+    // typeUnit.
+    std::unordered_map<std::string, StructType*> structTypes;
+    std::string typeUnit;
+
+    // What was registered since recordRegistrations, while recording
+    struct Registrations {
+        std::vector<std::string> identifiers;
+        std::vector<std::string> globalIdentifiers;
+        std::vector<std::string> structTypes;
+        // unit, imported unit
+        std::vector<std::pair<std::string, std::string> > imports;
+        std::vector<std::string> units;
+    };
+
+    std::optional<Registrations> registrations;
+
     std::unordered_map<std::string, Constant*> internedStrings;
 
+    std::unordered_map<std::string, UnitMemory> unitMemory;
+
     std::unique_ptr<DebugInfo> buildErrorDebugInfo;
     std::string buildError;
 
+    // Unit of the code currently being generated
+    std::string codegenUnit;
+
+    // Debug info (-g); every unit is a separate DWARF compile unit with its own builder
+    struct DebugUnit {
+        std::unique_ptr<DIBuilder> builder;
+        DICompileUnit* compileUnit;
+        DIFile* file;
+        // Struct names are resolved per unit, so their debug types are too
+        std::unordered_map<GeneratedType*, DIType*> types;
+    };
+
+    std::unordered_map<std::string, DebugUnit> debugUnits;
+
+    DIType* debugType(GeneratedType* type);
+
+    void describeVariable(const std::string& identifier, GeneratedType* type, AllocaInst* varAlloca, unsigned argNo);
+
+    // Finishes the debug info of every unit and destroys the builders; no debug info can be added afterwards
+    void finalizeDebugInfo();
+
+    // --instrument-functions: function names by id, and the id of every instrumented function
+    std::vector<std::string> instrumentedNames;
+    std::unordered_map<const Function*, uint32_t> instrumentedIds;
+
+    // Emits the id -> name table the tracing runtime uses to name functions
+    void emitInstrumentationTable();
+
+    // --coverage: the source range of every counter, by counter index
+    struct CoverageRegion {
+        std::string file;
+        int startLine;
+        int startColumn;
+        int endLine;
+        int endColumn;
+    };
+
+    std::vector<CoverageRegion> coverageRegions;
+    // Stand-in for the counter array until the number of regions is known
+    GlobalVariable* coverageCounters = nullptr;
+
+    // Emits the counter array and the region table the coverage runtime reports from
+    void emitCoverageTable();
+
+    // --alloc-profile: where every allocation site is, by site id
+    struct AllocSite {
+        std::string unit;
+        std::string function;
+        int line;
+        std::string type;
+    };
+
+    std::vector<AllocSite> allocSites;
+
+    void emitAllocSiteTable();
+
 public:
     std::nullptr_t setError(const DebugInfo& debugInfo, const std::string& error);
 
@@ -65,20 +187,103 @@ public:
 
     bool registerUnit(const std::string& unit);
 
+    // Registers a unit imported by another unit, so dependents can be found for incremental builds
+    bool registerImport(const std::string& unit, const std::string& imported);
+
     bool registerGlobalIdentifier(const std::string& unit,
                                   const std::string& identifier,
                                   std::unique_ptr<Identifier> val);
 
     bool useGlobalIdentifier(const std::string& unit, const std::string& identifier, const std::string& alias);
 
+    // Registers a struct name of unit; inlineType is the struct's LLVM type for inline structs, nullptr for everything
+    // else. Registering a name again is fine as long as it means the same type.
+    bool registerStructType(const std::string& unit, const std::string& name, StructType* inlineType);
+
+    // Type names are resolved in this unit from now on, i.e. the unit being declared or generated
+    void enterTypeUnit(const std::string& unit);
+
+    // The LLVM type of the inline struct name refers to in unit, or nullptr
+    StructType* getInlineStructType(const std::string& unit, const std::string& name) const;
+
+    // Same, in the current type unit. Values can have types their unit never names (i.e. the result of an imported
+    // function), so a name the unit doesn't know resolves to the inline struct of that name if only one unit has one.
+    StructType* getInlineStructType(const std::string& name) const;
+
+    // Keeps parsed units (and their lexers) alive between builds in this process, i.e. in the daemon.
+    // A cached unit is reused as long as its file's modification time and size are unchanged, and so is its code
+    // unless it imports a unit that changed.
+    static void enableUnitCache();
+
     bool compileModule();
 
+    // Parses, registers and codegens every unit registered since the last call (i.e. new imports)
+    bool compileUnits();
+
+    // Paths of every unit in the module, after compileModule
+    std::vector<std::filesystem::path> unitPaths();
+
+    size_t unitCount() const;
+
+    // Units that had to be codegenned in this build; only less than unitCount in incremental builds
+    size_t recompiledUnitCount() const;
+
+    // Formats the current build error against the source of the given lexer
+    std::string formatBuildError(Lexer& lexer, const std::string& unit, const std::string& filename);
+
+    // Swaps in a new, empty module with the same context and returns the old one. Declarations of the old module stay
+    // registered, and are redeclared in the new module when used, so code can be compiled one module at a time.
+    std::unique_ptr<Module> startModule(const std::string& name);
+
+    // Starts recording every identifier, struct type, import and unit registered from here on, so they can be undone
+    // together (i.e. when a repl entry fails)
+    void recordRegistrations();
+
+    // Stops recording and keeps everything registered since recordRegistrations
+    void keepRegistrations();
+
+    // Stops recording and drops everything registered since recordRegistrations
+    void undoRegistrations();
+
+    // Sets the unit whose source the following code comes from (for debug info and coverage)
+    void enterCodegenUnit(const std::string& unit);
+
+    // Attaches a subprogram to a function whose body is about to be generated
+    void beginDebugFunction(Function* function, const std::string& name, const DebugInfo& debugInfo);
+
+    void endDebugFunction();
+
+    // Attributes the instructions generated from here on to the source of the given node
+    void setDebugLocation(const DebugInfo& debugInfo);
+
+    // Calls the function entry hook at the start of a function body
+    void instrumentEntry(Function* function);
+
+    // Calls the function exit hook of the current function; must come right before every return
+    void instrumentExit();
+
+    // Records an allocation site for --alloc-profile and returns its id
+    uint32_t registerAllocSite(GeneratedType* type, const DebugInfo& debugInfo);
+
+    // Counts every execution of the source range (i.e. of a block) for --coverage
+    void coverRegion(const DebugInfo& debugInfo);
+
+    // Runs the LLVM optimization pipeline for the configured opt level
+    bool optimize();
+
+    static void optimizeModule(Module& module, const ModuleConfig& config);
+
     bool writeIR();
 
+    void printMemReport(std::ostream& out);
+
     // codegen state
     std::unordered_map<std::string, std::unique_ptr<Identifier> > identifiers;
     std::vector<const GeneratedValue*> functionStack;
     std::vector<std::vector<std::string> > scopeStack;
+    // Variables defined at this scope depth become globals that outlive their function instead of allocas.
+    // Used by the repl so variables persist between entries.
+    std::optional<size_t> globalVarDepth;
 
     void enterFunc(const GeneratedValue* function);
 
@@ -92,19 +297,48 @@ public:
 
     bool registerIdentifier(const std::string& identifier, std::unique_ptr<Identifier> val);
 
+    // Traps unless condition holds and continues codegen after the check; nothing is emitted if it's constant true
+    void createBoundsCheck(Value* condition, const std::string& name);
+
 private:
     Identifier* getIdentifier(const std::string& identifier);
 
 public:
-    bool registerVar(const std::string& identifier, GeneratedType* type);
+    // Returns a declaration in the current module for globals that were defined in an earlier module
+    Value* importGlobal(Value* value);
+
+    // argNo is the 1-based position of function parameters (for debug info), or 0 for locals
+    bool registerVar(const std::string& identifier, GeneratedType* type, unsigned argNo = 0);
 
     // TODO: change to getidentifier
-    GeneratedValue* getVar(const std::string& identifier);
+    // A copy, since globals of other modules are imported into the current one and the stored identifier has to
+    // outlive it (i.e. a failed repl entry)
+    std::unique_ptr<GeneratedValue> getVar(const std::string& identifier);
 
     GeneratedStruct* getStruct(const std::string& identifier);
 
     // Globals
 
+    // Whether all code ends up in this one module. Incremental builds and the repl spread a program over many modules
+    // that reference each other by name, so every function has to stay externally visible.
+    bool singleModule() const;
+
+    // Whether every unit is codegenned into its own module and cached as bitcode: watch mode, and daemon builds
+    bool incrementalCodegen() const;
+
+    // Whether function bodies are generated on demand; incremental builds, the repl and coverage builds generate
+    // everything instead
+    bool deferringBodies() const;
+
+    // Registers a function body; roots are queued right away, everything else once it's referenced
+    void deferBody(const std::string& unit, const Value* function, FuncAST* body, bool root);
+
+    // Queues the body of a function if it hasn't been queued yet
+    void requireBody(const Value* function);
+
+    // Next body of the unit to generate, or nullptr
+    FuncAST* nextQueuedBody(const std::string& unit);
+
     // Gets a string intern if it already exists, otherwise creates it
     Constant* getInternedString(const std::string& strVal);
 };
@@ -0,0 +1,86 @@
+#include <format>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+#include <llvm/Support/Error.h>
+
+#include "timing.h"
+
+struct PhaseTotal {
+    const char* phase;
+    std::chrono::steady_clock::duration total;
+    size_t count;
+};
+
+static bool reportEnabled = false;
+static std::chrono::steady_clock::time_point enabledAt;
+static std::mutex totalsMutex;
+// Kept in order of first appearance so the report reads roughly in pipeline order
+static std::vector<PhaseTotal> totals;
+
+PhaseTimer::PhaseTimer(const char* phase, const std::string& detail): phase(phase), traceScope(phase, detail) {
+    if (reportEnabled) {
+        start = std::chrono::steady_clock::now();
+    }
+}
+
+PhaseTimer::~PhaseTimer() {
+    if (!reportEnabled) {
+        return;
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    std::lock_guard lock(totalsMutex);
+    for (auto& total: totals) {
+        // Phase names are always string literals, so pointer comparison is enough
+        if (total.phase == phase) {
+            total.total += elapsed;
+            total.count += 1;
+            return;
+        }
+    }
+    totals.push_back(PhaseTotal(phase, elapsed, 1));
+}
+
+void PhaseTimer::enable(const bool report, const bool trace) {
+    reportEnabled = report;
+    enabledAt = std::chrono::steady_clock::now();
+    {
+        // The daemon runs many builds in one process, so every build starts from an empty report
+        std::lock_guard lock(totalsMutex);
+        totals.clear();
+    }
+    if (trace) {
+        // Granularity of 0 records every scope, including very small functions
+        llvm::timeTraceProfilerInitialize(0, "Axon");
+    }
+}
+
+void PhaseTimer::printReport(std::ostream& out) {
+    using ms = std::chrono::duration<double, std::milli>;
+    auto wall = ms(std::chrono::steady_clock::now() - enabledAt).count();
+
+    std::lock_guard lock(totalsMutex);
+    out << "===== Axon time report =====" << std::endl;
+    out << std::format("{:>12} {:>8} {:>7}  {}", "Time (ms)", "Count", "%", "Phase") << std::endl;
+    for (const auto& [phase, total, count]: totals) {
+        auto totalMs = ms(total).count();
+        out << std::format("{:>12.3f} {:>8} {:>6.1f}%  {}", totalMs, count, 100 * totalMs / wall, phase) << std::endl;
+    }
+    // Phases nest (e.g. functions inside units), so the percentages intentionally don't sum to 100
+    out << std::format("{:>12.3f} {:>8} {:>6.1f}%  {}", wall, 1, 100.0, "total") << std::endl;
+}
+
+bool PhaseTimer::writeTrace(const std::filesystem::path& path) {
+    if (!llvm::timeTraceProfilerEnabled()) {
+        return false;
+    }
+    auto err = llvm::timeTraceProfilerWrite(path.string(), path.string());
+    llvm::timeTraceProfilerCleanup();
+    if (err) {
+        std::cerr << "Could not write time trace: " << llvm::toString(std::move(err)) << std::endl;
+        return false;
+    }
+    return true;
+}
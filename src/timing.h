@@ -0,0 +1,32 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+
+#include <llvm/Support/TimeProfiler.h>
+
+/// Scoped compile-time timer for a single compiler phase.
+/// Time is aggregated per phase for the --time-report table, and every scope is also recorded as an LLVM
+/// time trace event so --time-trace output contains our phases interleaved with LLVM's own pass timings.
+/// Timers are cheap no-ops unless enabled.
+class PhaseTimer {
+    const char* phase;
+    std::chrono::steady_clock::time_point start;
+    llvm::TimeTraceScope traceScope;
+
+public:
+    explicit PhaseTimer(const char* phase, const std::string& detail = "");
+
+    ~PhaseTimer();
+
+    PhaseTimer(const PhaseTimer&) = delete;
+
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+    static void enable(bool report, bool trace);
+
+    static void printReport(std::ostream& out);
+
+    static bool writeTrace(const std::filesystem::path& path);
+};
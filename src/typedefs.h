@@ -11,3 +11,6 @@ typedef std::variant<GeneratedValue, GeneratedStruct> Identifier;
 struct GeneratedType;
 
 typedef std::tuple<std::vector<GeneratedType*>, GeneratedType*> FunctionTypeBacker;
+
+// element type, lanes
+typedef std::tuple<GeneratedType*, unsigned> VectorTypeBacker;
@@ -18,12 +18,47 @@ std::vector<std::string> split(const std::string& str, const std::string& separa
     return parts;
 }
 
-std::string readStdin() {
-    std::cout << "code >" << std::endl;
+std::optional<std::string> readStdin() {
+    std::cout << "code > " << std::flush;
     std::string text;
     std::string line;
+    int depth = 0;
+    // Strings, chars and comments are skipped like the lexer does, so brackets inside them don't count
+    char quote = 0;
+    bool inBlockComment = false;
     while (getline(std::cin, line)) {
         text += line + "\n";
+        for (size_t i = 0; i < line.size(); i++) {
+            if (inBlockComment) {
+                if (line.compare(i, 2, "*/") == 0) {
+                    inBlockComment = false;
+                    i++;
+                }
+            } else if (quote) {
+                if (line[i] == quote) {
+                    quote = 0;
+                }
+            } else if (line[i] == '"' || line[i] == '\'') {
+                quote = line[i];
+            } else if (line.compare(i, 2, "//") == 0) {
+                break;
+            } else if (line.compare(i, 2, "/*") == 0) {
+                inBlockComment = true;
+                i++;
+            } else if (line[i] == '{' || line[i] == '(' || line[i] == '[') {
+                depth++;
+            } else if (line[i] == '}' || line[i] == ')' || line[i] == ']') {
+                depth--;
+            }
+        }
+        // An entry is done once every bracket it opened (and any block comment) is closed again
+        if (depth <= 0 && !inBlockComment) {
+            return text;
+        }
+        std::cout << "     > " << std::flush;
+    }
+    if (text.empty()) {
+        return std::nullopt;
     }
     return text;
 }
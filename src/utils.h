@@ -1,13 +1,15 @@
 #pragma once
 
 #include <filesystem>
+#include <optional>
 #include <vector>
 
 struct GeneratedType;
 
 std::vector<std::string> split(const std::string& str, const std::string& separator);
 
-std::string readStdin();
+// Reads one entry from stdin, i.e. lines until all opened brackets are closed. Returns nullopt at end of input.
+std::optional<std::string> readStdin();
 
 std::string readFile(const std::filesystem::path& filename);
 
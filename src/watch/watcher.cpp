@@ -0,0 +1,80 @@
+#include <cstring>
+#include <string>
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "watcher.h"
+#include "logging.h"
+
+// How long to wait for more events after the first one before rebuilding
+static constexpr int BATCH_MS = 20;
+
+FileWatcher::FileWatcher() {
+    inotifyFd = inotify_init1(IN_CLOEXEC);
+    if (inotifyFd < 0) {
+        logError(std::string("Could not initialize inotify: ") + std::strerror(errno));
+    }
+}
+
+FileWatcher::~FileWatcher() {
+    if (inotifyFd >= 0) {
+        close(inotifyFd);
+    }
+}
+
+bool FileWatcher::valid() const {
+    return inotifyFd >= 0;
+}
+
+bool FileWatcher::watchDirectory(const std::filesystem::path& directory) {
+    auto path = directory.empty() ? std::filesystem::path(".") : directory;
+    auto wd = inotify_add_watch(inotifyFd,
+                                path.c_str(),
+                                IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_MOVED_FROM);
+    if (wd < 0) {
+        logError("Could not watch " + path.string() + ": " + std::strerror(errno));
+        return false;
+    }
+    // inotify hands back the same descriptor for a directory that's already watched
+    directories[wd] = path;
+    return true;
+}
+
+std::vector<std::filesystem::path> FileWatcher::waitForChanges() {
+    std::vector<std::filesystem::path> changed;
+    alignas(inotify_event) char buffer[4096];
+    while (changed.empty()) {
+        // Block for the first event, then only keep reading while events keep arriving
+        int timeout = -1;
+        while (true) {
+            pollfd pfd{inotifyFd, POLLIN, 0};
+            auto ready = poll(&pfd, 1, timeout);
+            if (ready < 0 && errno == EINTR) {
+                continue;
+            }
+            if (ready <= 0) {
+                break;
+            }
+
+            auto length = read(inotifyFd, buffer, sizeof(buffer));
+            if (length <= 0) {
+                break;
+            }
+            for (char* cur = buffer; cur < buffer + length;) {
+                auto* event = reinterpret_cast<inotify_event*>(cur);
+                cur += sizeof(inotify_event) + event->len;
+                if (event->len == 0 || !directories.contains(event->wd)) {
+                    continue;
+                }
+                auto path = directories.at(event->wd) / event->name;
+                if (path.extension() == ".ax" || path.extension() == ".toml") {
+                    changed.push_back(path);
+                }
+            }
+            timeout = BATCH_MS;
+        }
+    }
+    return changed;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <filesystem>
+#include <unordered_map>
+#include <vector>
+
+/// Waits for source files to change using inotify.
+/// Directories are watched rather than the files themselves, since many editors save by writing a new file and
+/// renaming it over the old one, which would silently end a watch on the old file.
+class FileWatcher {
+    int inotifyFd;
+    // watch descriptor -> directory
+    std::unordered_map<int, std::filesystem::path> directories;
+
+public:
+    FileWatcher();
+
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    bool valid() const;
+
+    // Watching the same directory again is a no-op
+    bool watchDirectory(const std::filesystem::path& directory);
+
+    // Blocks until a unit (.ax) or build file (.toml) in a watched directory changes, and returns the changed paths.
+    // Changes arriving in quick succession are batched, so saving several files at once only triggers one rebuild.
+    std::vector<std::filesystem::path> waitForChanges();
+};